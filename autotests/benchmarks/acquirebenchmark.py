@@ -0,0 +1,241 @@
+#!/usr/bin/env python3
+#
+# Copyright © 2026 The LingmoOS Developers
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License as
+# published by the Free Software Foundation; either version 2 of
+# the License or (at your option) version 3 or any later version
+# accepted by the membership of KDE e.V. (or its successor approved
+# by the membership of KDE e.V.), which shall act as a proxy
+# defined in Section 14 of version 3 of the license.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+"""
+Measures the download throughput of the APT options behind the acquire
+settings of QApt::Transaction (queueMode, maxParallelDownloads,
+pipelineDepth and downloadRetries).
+
+A local stand-in for several mirrors is served on 127.0.0.1 to 127.0.0.N,
+one address per host, since APT queues downloads by host name. Every
+request that isn't pipelined behind another one is delayed like a round
+trip to a remote mirror, and every connection is throttled like a mirror's
+per-connection bandwidth. The
+files are then fetched with apt-helper, which uses the same pkgAcquire as
+the worker, once for each setting. No network is needed.
+
+Run it as root, or as a user that APT may drop its methods to:
+
+    python3 autotests/benchmarks/acquirebenchmark.py
+"""
+
+import argparse
+import http.server
+import os
+import select
+import shutil
+import socketserver
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+APT_HELPER = "/usr/lib/apt/apt-helper"
+
+# (description, APT options)
+SETTINGS = [
+    ("APT defaults", []),
+    ("queueMode=access", ["Acquire::Queue-Mode=access"]),
+    ("maxParallelDownloads=1", ["Acquire::QueueHost::Limit=1"]),
+    ("maxParallelDownloads=2", ["Acquire::QueueHost::Limit=2"]),
+    ("maxParallelDownloads=8", ["Acquire::QueueHost::Limit=8"]),
+    ("pipelineDepth=0", ["Acquire::http::Pipeline-Depth=0"]),
+    ("pipelineDepth=10", ["Acquire::http::Pipeline-Depth=10"]),
+    ("pipelineDepth=0, maxParallelDownloads=1",
+     ["Acquire::http::Pipeline-Depth=0", "Acquire::QueueHost::Limit=1"]),
+]
+
+# Run against a stand-in that fails the first request of every file
+RETRY_SETTINGS = [
+    ("downloadRetries=0", ["Acquire::Retries=0"]),
+    ("downloadRetries=3", ["Acquire::Retries=3"]),
+]
+
+
+class MirrorHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    # Unbuffered, so that select() tells whether a request is waiting
+    rbufsize = 0
+    pipelined = False
+
+    def do_GET(self):
+        try:
+            self.respond()
+        finally:
+            # A request sent before this response was done has already
+            # made its way to the mirror, as it would with a real round trip
+            self.pipelined = bool(select.select([self.connection], [], [], 0)[0])
+
+    def respond(self):
+        server = self.server
+        name = os.path.basename(self.path)
+        path = os.path.join(server.root, name)
+
+        if self.pipelined:
+            with server.lock:
+                server.pipelined += 1
+        else:
+            time.sleep(server.latency)
+
+        if server.flaky:
+            with server.lock:
+                failed = name in server.failed
+                server.failed.add(name)
+            if not failed:
+                self.send_error(503)
+                return
+
+        if not os.path.isfile(path):
+            self.send_error(404)
+            return
+
+        with open(path, "rb") as f:
+            data = f.read()
+
+        self.send_response(200)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+
+        # Throttled per connection
+        chunk = 16 * 1024
+        delay = chunk / server.rate
+        for offset in range(0, len(data), chunk):
+            time.sleep(delay)
+            self.wfile.write(data[offset:offset + chunk])
+
+    def log_message(self, format, *args):
+        pass
+
+
+class MirrorServer(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+def start_mirrors(args, root, flaky):
+    servers = []
+    for i in range(args.hosts):
+        server = MirrorServer(("127.0.0.%d" % (i + 1), args.port), MirrorHandler)
+        server.root = root
+        server.latency = args.latency / 1000.0
+        server.rate = args.rate * 1024.0
+        server.flaky = flaky
+        server.failed = set()
+        server.pipelined = 0
+        server.lock = threading.Lock()
+        threading.Thread(target=server.serve_forever, daemon=True).start()
+        servers.append(server)
+    return servers
+
+
+def stop_mirrors(servers):
+    for server in servers:
+        server.shutdown()
+        server.server_close()
+
+
+def fetch(args, files, target, options):
+    shutil.rmtree(target, ignore_errors=True)
+    os.makedirs(target)
+    os.chmod(target, 0o777)
+
+    command = [APT_HELPER, "-q", "download-file"]
+    for option in options:
+        command += ["-o", option]
+
+    for i, name in enumerate(files):
+        host = "127.0.0.%d" % (i % args.hosts + 1)
+        command += ["http://%s:%d/%s" % (host, args.port, name),
+                    os.path.join(target, name)]
+
+    start = time.monotonic()
+    result = subprocess.run(command, stdout=subprocess.DEVNULL,
+                            stderr=subprocess.DEVNULL)
+    elapsed = time.monotonic() - start
+
+    fetched = sum(os.path.isfile(os.path.join(target, name)) for name in files)
+    size = sum(os.path.getsize(os.path.join(target, name))
+               for name in files if os.path.isfile(os.path.join(target, name)))
+    return result.returncode == 0, fetched, size, elapsed
+
+
+def run(args, files, work, flaky, settings):
+    servers = start_mirrors(args, os.path.join(work, "mirror"), flaky)
+    try:
+        for description, options in settings:
+            times = []
+            for _ in range(args.runs):
+                for server in servers:
+                    server.failed.clear()
+                    server.pipelined = 0
+                success, fetched, size, elapsed = fetch(
+                    args, files, os.path.join(work, "target"), options)
+                times.append(elapsed)
+
+            elapsed = sorted(times)[len(times) // 2]
+            pipelined = sum(server.pipelined for server in servers)
+            print("%-42s %3d/%d files %7.2f s %6.2f MiB/s %4d pipelined%s" % (
+                description, fetched, len(files), elapsed,
+                size / elapsed / 1024 / 1024, pipelined,
+                "" if success else "  (failed)"))
+    finally:
+        stop_mirrors(servers)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--hosts", type=int, default=4, help="number of mirror hosts")
+    parser.add_argument("--files", type=int, default=32, help="number of archives")
+    parser.add_argument("--size", type=int, default=512, help="archive size in KiB")
+    parser.add_argument("--latency", type=int, default=100,
+                        help="delay before each response in milliseconds")
+    parser.add_argument("--rate", type=int, default=2048,
+                        help="bandwidth of each connection in KiB/s")
+    parser.add_argument("--port", type=int, default=8642)
+    parser.add_argument("--runs", type=int, default=3,
+                        help="runs per setting, the median is shown")
+    args = parser.parse_args()
+
+    if not os.access(APT_HELPER, os.X_OK):
+        sys.exit("%s is needed" % APT_HELPER)
+
+    work = tempfile.mkdtemp(prefix="qapt-acquire-")
+    os.chmod(work, 0o755)
+    try:
+        mirror = os.path.join(work, "mirror")
+        os.makedirs(mirror)
+        files = ["archive%03d.deb" % i for i in range(args.files)]
+        for name in files:
+            with open(os.path.join(mirror, name), "wb") as f:
+                f.write(os.urandom(args.size * 1024))
+
+        print("%d archives of %d KiB on %d hosts, %d ms latency, %d KiB/s per connection\n"
+              % (args.files, args.size, args.hosts, args.latency, args.rate))
+        run(args, files, work, False, SETTINGS)
+        print("\nFirst request of every archive fails:")
+        run(args, files, work, True, RETRY_SETTINGS)
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,371 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include <QtTest>
+
+#include <QRandomGenerator>
+
+#include "transactionscheduler.h"
+
+typedef TransactionScheduler::Resources Resources;
+
+class TransactionSchedulerTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testRoleResources();
+    void testConflictingRunInOrder();
+    void testIndependentRunConcurrently();
+    void testSlotLimit();
+    void testWaitingReservesResources();
+    void testWaitingReservesSlot();
+    void testExclusive();
+    void testRemove();
+    void testPriorityOrder();
+    void testPreemption();
+    void testCoalesce();
+    void testRandomWorkload();
+};
+
+void TransactionSchedulerTest::testRoleResources()
+{
+    QCOMPARE(TransactionScheduler::roleResources(QApt::UpdateCacheRole),
+             Resources(TransactionScheduler::ListsResource));
+    QCOMPARE(TransactionScheduler::roleResources(QApt::CommitChangesRole),
+             TransactionScheduler::ArchivesResource | TransactionScheduler::StatusResource);
+    QCOMPARE(TransactionScheduler::roleResources(QApt::UpgradeSystemRole),
+             TransactionScheduler::ArchivesResource | TransactionScheduler::StatusResource);
+    QCOMPARE(TransactionScheduler::roleResources(QApt::InstallFileRole),
+             Resources(TransactionScheduler::StatusResource));
+    QCOMPARE(TransactionScheduler::roleResources(QApt::DownloadArchivesRole),
+             Resources(TransactionScheduler::NoResources));
+    QCOMPARE(TransactionScheduler::roleResources(QApt::RebuildCacheRole),
+             Resources(TransactionScheduler::NoResources));
+    QCOMPARE(TransactionScheduler::roleResources(QApt::EmptyRole),
+             Resources(TransactionScheduler::ExclusiveResource));
+}
+
+void TransactionSchedulerTest::testConflictingRunInOrder()
+{
+    TransactionScheduler scheduler(3);
+    const Resources commit = TransactionScheduler::roleResources(QApt::CommitChangesRole);
+
+    scheduler.enqueue(QStringLiteral("a"), commit);
+    scheduler.enqueue(QStringLiteral("b"), commit);
+    scheduler.enqueue(QStringLiteral("c"), commit);
+
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("a"));
+    QCOMPARE(scheduler.schedule(), QStringList());
+
+    scheduler.finish(QStringLiteral("a"));
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("b"));
+
+    scheduler.finish(QStringLiteral("b"));
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("c"));
+
+    scheduler.finish(QStringLiteral("c"));
+    QVERIFY(scheduler.isEmpty());
+}
+
+void TransactionSchedulerTest::testIndependentRunConcurrently()
+{
+    TransactionScheduler scheduler(3);
+
+    scheduler.enqueue(QStringLiteral("commit"),
+                      TransactionScheduler::roleResources(QApt::CommitChangesRole));
+    scheduler.enqueue(QStringLiteral("update"),
+                      TransactionScheduler::roleResources(QApt::UpdateCacheRole));
+    scheduler.enqueue(QStringLiteral("download"),
+                      TransactionScheduler::roleResources(QApt::DownloadArchivesRole));
+
+    const QStringList expected = QStringList() << QStringLiteral("commit")
+                                               << QStringLiteral("update")
+                                               << QStringLiteral("download");
+    QCOMPARE(scheduler.schedule(), expected);
+    QCOMPARE(scheduler.running(), expected);
+    QVERIFY(scheduler.queued().isEmpty());
+}
+
+void TransactionSchedulerTest::testSlotLimit()
+{
+    TransactionScheduler scheduler(2);
+
+    for (int i = 0; i < 3; ++i)
+        scheduler.enqueue(QString::number(i), TransactionScheduler::NoResources);
+
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("0") << QStringLiteral("1"));
+
+    scheduler.finish(QStringLiteral("1"));
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("2"));
+    QCOMPARE(scheduler.running(), QStringList() << QStringLiteral("0") << QStringLiteral("2"));
+}
+
+void TransactionSchedulerTest::testWaitingReservesResources()
+{
+    TransactionScheduler scheduler(3);
+
+    // "b" waits for the dpkg status held by "a". "c" only needs the free
+    // archives, but may not take them from under "b"
+    scheduler.enqueue(QStringLiteral("a"), TransactionScheduler::StatusResource);
+    scheduler.enqueue(QStringLiteral("b"), TransactionScheduler::ArchivesResource |
+                                           TransactionScheduler::StatusResource);
+    scheduler.enqueue(QStringLiteral("c"), TransactionScheduler::ArchivesResource);
+    scheduler.enqueue(QStringLiteral("d"), TransactionScheduler::ListsResource);
+
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("a") << QStringLiteral("d"));
+    QCOMPARE(scheduler.queued(), QStringList() << QStringLiteral("b") << QStringLiteral("c"));
+
+    scheduler.finish(QStringLiteral("a"));
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("b"));
+
+    scheduler.finish(QStringLiteral("b"));
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("c"));
+}
+
+void TransactionSchedulerTest::testWaitingReservesSlot()
+{
+    TransactionScheduler scheduler(3);
+
+    scheduler.enqueue(QStringLiteral("a"), TransactionScheduler::StatusResource);
+    scheduler.enqueue(QStringLiteral("b"), TransactionScheduler::StatusResource);
+    for (int i = 0; i < 3; ++i)
+        scheduler.enqueue(QStringLiteral("download%1").arg(i), TransactionScheduler::NoResources);
+
+    // One slot stays free for "b", so downloads can't crowd it out
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("a")
+                                                 << QStringLiteral("download0"));
+
+    scheduler.finish(QStringLiteral("a"));
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("b")
+                                                 << QStringLiteral("download1"));
+
+    // The strict order of a single slot is kept as well
+    TransactionScheduler serial(1);
+    serial.enqueue(QStringLiteral("a"), TransactionScheduler::StatusResource);
+    serial.enqueue(QStringLiteral("b"), TransactionScheduler::NoResources);
+    QCOMPARE(serial.schedule(), QStringList() << QStringLiteral("a"));
+    QCOMPARE(serial.schedule(), QStringList());
+}
+
+void TransactionSchedulerTest::testExclusive()
+{
+    TransactionScheduler scheduler(3);
+
+    scheduler.enqueue(QStringLiteral("a"), TransactionScheduler::ListsResource);
+    scheduler.enqueue(QStringLiteral("b"), TransactionScheduler::ExclusiveResource);
+    scheduler.enqueue(QStringLiteral("c"), TransactionScheduler::NoResources);
+
+    // Nothing overtakes "b" while it waits for "a"
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("a"));
+
+    scheduler.finish(QStringLiteral("a"));
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("b"));
+
+    // Nothing runs alongside it either
+    QCOMPARE(scheduler.schedule(), QStringList());
+
+    scheduler.finish(QStringLiteral("b"));
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("c"));
+}
+
+void TransactionSchedulerTest::testRemove()
+{
+    TransactionScheduler scheduler(1);
+
+    scheduler.enqueue(QStringLiteral("a"), TransactionScheduler::StatusResource);
+    scheduler.enqueue(QStringLiteral("b"), TransactionScheduler::StatusResource);
+    scheduler.schedule();
+
+    QVERIFY(!scheduler.remove(QStringLiteral("a")));
+    QVERIFY(scheduler.remove(QStringLiteral("b")));
+    QVERIFY(!scheduler.remove(QStringLiteral("b")));
+
+    scheduler.finish(QStringLiteral("a"));
+    QCOMPARE(scheduler.schedule(), QStringList());
+    QVERIFY(scheduler.isEmpty());
+}
+
+void TransactionSchedulerTest::testPriorityOrder()
+{
+    TransactionScheduler scheduler(3);
+    const Resources commit = TransactionScheduler::roleResources(QApt::CommitChangesRole);
+
+    scheduler.enqueue(QStringLiteral("running"), commit);
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("running"));
+
+    scheduler.enqueue(QStringLiteral("background"), commit, QApt::BackgroundPriority);
+    scheduler.enqueue(QStringLiteral("normal"), commit);
+    scheduler.enqueue(QStringLiteral("interactive"), commit, QApt::InteractivePriority);
+    scheduler.enqueue(QStringLiteral("security"), commit, QApt::SecurityPriority);
+    scheduler.enqueue(QStringLiteral("interactive2"), commit, QApt::InteractivePriority);
+
+    QCOMPARE(scheduler.queued(), QStringList() << QStringLiteral("interactive")
+                                               << QStringLiteral("interactive2")
+                                               << QStringLiteral("security")
+                                               << QStringLiteral("normal")
+                                               << QStringLiteral("background"));
+}
+
+void TransactionSchedulerTest::testPreemption()
+{
+    TransactionScheduler scheduler(2);
+    const Resources update = TransactionScheduler::roleResources(QApt::UpdateCacheRole);
+    const Resources commit = TransactionScheduler::roleResources(QApt::CommitChangesRole);
+
+    scheduler.enqueue(QStringLiteral("refresh"), update, QApt::BackgroundPriority);
+    scheduler.enqueue(QStringLiteral("fetch"), commit, QApt::BackgroundPriority);
+    QCOMPARE(scheduler.schedule().size(), 2);
+
+    // Background work doesn't preempt background work
+    scheduler.enqueue(QStringLiteral("later"), update, QApt::BackgroundPriority);
+    QVERIFY(scheduler.schedule().isEmpty());
+    QVERIFY(scheduler.preemptionCandidates().isEmpty());
+    QVERIFY(scheduler.remove(QStringLiteral("later")));
+
+    // The install conflicts with "fetch" only, and needs a free slot
+    scheduler.enqueue(QStringLiteral("install"), commit, QApt::InteractivePriority);
+    QVERIFY(scheduler.schedule().isEmpty());
+    QCOMPARE(scheduler.preemptionCandidates(),
+             QStringList() << QStringLiteral("fetch"));
+
+    QVERIFY(scheduler.requeue(QStringLiteral("fetch")));
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("install"));
+    QCOMPARE(scheduler.queued(), QStringList() << QStringLiteral("fetch"));
+    QVERIFY(scheduler.preemptionCandidates().isEmpty());
+
+    // Only background work makes way, so requeueing "refresh" wouldn't help
+    scheduler.enqueue(QStringLiteral("security"), commit, QApt::SecurityPriority);
+    QVERIFY(scheduler.schedule().isEmpty());
+    QVERIFY(scheduler.preemptionCandidates().isEmpty());
+
+    // The requeued transaction keeps its place among background work
+    scheduler.finish(QStringLiteral("install"));
+    scheduler.enqueue(QStringLiteral("later"), update, QApt::BackgroundPriority);
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("security"));
+    QCOMPARE(scheduler.queued(), QStringList() << QStringLiteral("fetch")
+                                               << QStringLiteral("later"));
+}
+
+void TransactionSchedulerTest::testCoalesce()
+{
+    const Resources commit = TransactionScheduler::ArchivesResource | TransactionScheduler::StatusResource;
+    const Resources update = TransactionScheduler::ListsResource;
+    TransactionScheduler scheduler(3);
+
+    scheduler.enqueue(QStringLiteral("lead"), commit);
+    scheduler.enqueue(QStringLiteral("update"), update);
+    scheduler.enqueue(QStringLiteral("first"), commit);
+    scheduler.enqueue(QStringLiteral("second"), commit);
+    scheduler.enqueue(QStringLiteral("third"), commit);
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("lead")
+                                                 << QStringLiteral("update"));
+
+    // Only queued transactions with the same resources join running ones
+    QVERIFY(!scheduler.coalesce(QStringLiteral("first"), QStringLiteral("second")));
+    QVERIFY(!scheduler.coalesce(QStringLiteral("update"), QStringLiteral("first")));
+    QVERIFY(scheduler.coalesce(QStringLiteral("lead"), QStringLiteral("first")));
+    QVERIFY(scheduler.coalesce(QStringLiteral("lead"), QStringLiteral("second")));
+    QVERIFY(!scheduler.coalesce(QStringLiteral("lead"), QStringLiteral("second")));
+    QCOMPARE(scheduler.coalesced(QStringLiteral("lead")),
+             QStringList() << QStringLiteral("first") << QStringLiteral("second"));
+    QCOMPARE(scheduler.queued(), QStringList() << QStringLiteral("third"));
+
+    // A coalesced transaction can go back on its own, to its old place
+    QVERIFY(scheduler.requeue(QStringLiteral("first")));
+    QCOMPARE(scheduler.queued(), QStringList() << QStringLiteral("first")
+                                               << QStringLiteral("third"));
+    QVERIFY(scheduler.remove(QStringLiteral("second")));
+    QVERIFY(scheduler.coalesced(QStringLiteral("lead")).isEmpty());
+
+    // Requeueing the lead requeues what it carries
+    QVERIFY(scheduler.coalesce(QStringLiteral("lead"), QStringLiteral("third")));
+    QVERIFY(scheduler.requeue(QStringLiteral("lead")));
+    QCOMPARE(scheduler.queued(), QStringList() << QStringLiteral("lead")
+                                               << QStringLiteral("first")
+                                               << QStringLiteral("third"));
+
+    // Finishing the lead finishes what it carries
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("lead"));
+    QVERIFY(scheduler.coalesce(QStringLiteral("lead"), QStringLiteral("first")));
+    scheduler.finish(QStringLiteral("lead"));
+    QVERIFY(!scheduler.requeue(QStringLiteral("first")));
+    scheduler.finish(QStringLiteral("update"));
+    QCOMPARE(scheduler.schedule(), QStringList() << QStringLiteral("third"));
+    scheduler.finish(QStringLiteral("third"));
+    QVERIFY(scheduler.isEmpty());
+}
+
+void TransactionSchedulerTest::testRandomWorkload()
+{
+    const Resources choices[] = {
+        TransactionScheduler::ListsResource,
+        TransactionScheduler::ArchivesResource | TransactionScheduler::StatusResource,
+        TransactionScheduler::StatusResource,
+        TransactionScheduler::NoResources,
+        TransactionScheduler::ExclusiveResource
+    };
+    const int choiceCount = sizeof(choices) / sizeof(choices[0]);
+
+    QRandomGenerator generator(4711);
+    TransactionScheduler scheduler(3);
+    QHash<QString, Resources> resources;
+    QHash<QString, int> waitedRounds;
+    int next = 0;
+
+    for (int round = 0; round < 20000 || !scheduler.isEmpty(); ++round) {
+        if (round < 20000 && generator.bounded(4) == 0) {
+            const QString id = QString::number(next++);
+            resources.insert(id, choices[generator.bounded(choiceCount)]);
+            scheduler.enqueue(id, resources.value(id));
+        }
+
+        const QStringList running = scheduler.running();
+        if (!running.isEmpty() && generator.bounded(4) != 0)
+            scheduler.finish(running.at(generator.bounded(running.size())));
+
+        scheduler.schedule();
+
+        // Running transactions never share a resource, and a transaction
+        // that needs to run alone does
+        const QStringList nowRunning = scheduler.running();
+        QVERIFY(nowRunning.size() <= scheduler.maxRunning());
+
+        Resources busy;
+        for (const QString &id : nowRunning) {
+            const Resources needed = resources.value(id);
+            QVERIFY(!(busy & needed));
+            if (needed & TransactionScheduler::ExclusiveResource)
+                QCOMPARE(nowRunning.size(), 1);
+            busy |= needed;
+        }
+
+        // Every queued transaction gets to run eventually
+        for (const QString &id : scheduler.queued()) {
+            int &waited = waitedRounds[id];
+            QVERIFY2(++waited < 1000, qPrintable(QStringLiteral("%1 is starved").arg(id)));
+        }
+    }
+
+    QCOMPARE(next, resources.size());
+}
+
+QTEST_MAIN(TransactionSchedulerTest);
+
+#include "transactionschedulertest.moc"
@@ -0,0 +1,187 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include <QtTest>
+
+#include <QRandomGenerator>
+
+#include <apt-pkg/debversion.h>
+
+#include <versionkey.h>
+
+namespace QApt {
+
+class VersionKeyTest : public QObject
+{
+    Q_OBJECT
+private slots:
+    void testCompare_data();
+    void testCompare();
+    void testSortByVersion();
+    void testNewerThan();
+    void testMatchesApt();
+
+private:
+    static int aptCompare(const QString &a, const QString &b);
+    static QString randomVersion(QRandomGenerator &generator);
+};
+
+static int sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+int VersionKeyTest::aptCompare(const QString &a, const QString &b)
+{
+    // debVS is what _system->VS points to on Debian systems
+    const QByteArray va = a.toUtf8();
+    const QByteArray vb = b.toUtf8();
+    return sign(debVS.DoCmpVersion(va.constData(), va.constData() + va.size(),
+                                   vb.constData(), vb.constData() + vb.size()));
+}
+
+QString VersionKeyTest::randomVersion(QRandomGenerator &generator)
+{
+    static const char alphabet[] = "0000111223456789abczABZ..++~~~";
+    static const int alphabetSize = sizeof(alphabet) - 1;
+
+    auto randomPart = [&](int maxLength) {
+        QString part;
+        const int length = generator.bounded(1, maxLength + 1);
+        for (int i = 0; i < length; ++i) {
+            part.append(QLatin1Char(alphabet[generator.bounded(alphabetSize)]));
+        }
+        return part;
+    };
+
+    QString version;
+    if (generator.bounded(4) == 0) {
+        version += QString::number(generator.bounded(3)) + QLatin1Char(':');
+    }
+
+    // Upstream versions start with a digit as required by Debian policy
+    version += QString::number(generator.bounded(12)) + randomPart(6);
+
+    switch (generator.bounded(4)) {
+    case 0:
+        break;
+    case 1:
+        version += QLatin1Char('-') + randomPart(4);
+        break;
+    default:
+        version += QLatin1Char('-') + randomPart(3) + QLatin1Char('-') + randomPart(3);
+        break;
+    }
+
+    return version;
+}
+
+void VersionKeyTest::testCompare_data()
+{
+    QTest::addColumn<QString>("a");
+    QTest::addColumn<QString>("b");
+    QTest::addColumn<int>("result");
+
+    QTest::newRow("equal") << QStringLiteral("1.0") << QStringLiteral("1.0") << 0;
+    QTest::newRow("numeric") << QStringLiteral("1.9") << QStringLiteral("1.10") << -1;
+    QTest::newRow("leading zeros") << QStringLiteral("1.01") << QStringLiteral("1.1") << 0;
+    QTest::newRow("trailing zero") << QStringLiteral("1.0") << QStringLiteral("1.00") << 0;
+    QTest::newRow("longer") << QStringLiteral("1.0") << QStringLiteral("1.0.1") << -1;
+    QTest::newRow("tilde") << QStringLiteral("1.0~rc1") << QStringLiteral("1.0") << -1;
+    QTest::newRow("double tilde") << QStringLiteral("1.0~~") << QStringLiteral("1.0~") << -1;
+    QTest::newRow("letter after number") << QStringLiteral("1.0a") << QStringLiteral("1.0") << 1;
+    QTest::newRow("letters before punctuation") << QStringLiteral("1.0a") << QStringLiteral("1.0+") << -1;
+    QTest::newRow("epoch") << QStringLiteral("1:0.1") << QStringLiteral("2.0") << 1;
+    QTest::newRow("zero epoch") << QStringLiteral("0:2.0") << QStringLiteral("2.0") << 0;
+    QTest::newRow("revision") << QStringLiteral("2.0-1") << QStringLiteral("2.0-2") << -1;
+    QTest::newRow("missing revision") << QStringLiteral("2.0") << QStringLiteral("2.0-0") << 0;
+    QTest::newRow("dash in upstream") << QStringLiteral("2.0-beta-1") << QStringLiteral("2.0-1") << 1;
+    QTest::newRow("ubuntu") << QStringLiteral("5.27.8-0ubuntu1") << QStringLiteral("5.27.8-0ubuntu1.1") << -1;
+}
+
+void VersionKeyTest::testCompare()
+{
+    QFETCH(QString, a);
+    QFETCH(QString, b);
+    QFETCH(int, result);
+
+    QCOMPARE(sign(VersionKey(a).compare(VersionKey(b))), result);
+    QCOMPARE(sign(VersionKey(b).compare(VersionKey(a))), -result);
+    QCOMPARE(aptCompare(a, b), result);
+}
+
+void VersionKeyTest::testSortByVersion()
+{
+    const QStringList versions = { "1.0-1", "1:0.5", "1.0~rc1-1", "0.9", "1.0-1ubuntu1", "1.0" };
+    const QStringList expected = { "0.9", "1.0~rc1-1", "1.0", "1.0-1", "1.0-1ubuntu1", "1:0.5" };
+
+    QCOMPARE(VersionKey::sortByVersion(versions), expected);
+}
+
+void VersionKeyTest::testNewerThan()
+{
+    const QStringList versions = { "2.1-1", "2.0-2", "2.0-1", "1.9-3", "2.0" };
+
+    QCOMPARE(VersionKey::newerThan(versions, QStringLiteral("2.0-1")),
+             QStringList({ "2.1-1", "2.0-2" }));
+}
+
+void VersionKeyTest::testMatchesApt()
+{
+    QRandomGenerator generator(0x51a9);
+
+    QStringList corpus;
+    for (int i = 0; i < 5000; ++i) {
+        corpus.append(randomVersion(generator));
+    }
+
+    QList<VersionKey> keys;
+    keys.reserve(corpus.size());
+    for (const QString &version : std::as_const(corpus)) {
+        keys.append(VersionKey(version));
+    }
+
+    // Random pairs first, then neighbours in the sorted corpus
+    for (int i = 0; i < 200000; ++i) {
+        const int a = generator.bounded(corpus.size());
+        const int b = generator.bounded(corpus.size());
+
+        const int expected = aptCompare(corpus.at(a), corpus.at(b));
+        if (sign(keys.at(a).compare(keys.at(b))) != expected) {
+            QFAIL(qPrintable(QStringLiteral("%1 vs %2: expected %3")
+                             .arg(corpus.at(a), corpus.at(b)).arg(expected)));
+        }
+    }
+
+    VersionKey::sort(keys);
+    for (int i = 1; i < keys.size(); ++i) {
+        const QString &previous = keys.at(i - 1).version();
+        const QString &current = keys.at(i).version();
+        if (aptCompare(previous, current) > 0) {
+            QFAIL(qPrintable(QStringLiteral("%1 sorted before %2").arg(previous, current)));
+        }
+    }
+}
+
+}
+
+QTEST_MAIN(QApt::VersionKeyTest);
+
+#include "versionkeytest.moc"
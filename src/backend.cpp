@@ -24,6 +24,10 @@
 #include <QByteArray>
 #include <QTemporaryFile>
 #include <QDBusConnection>
+#include <QReadWriteLock>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtConcurrent/QtConcurrentRun>
 
 // Apt includes
 #include <apt-pkg/acquire.h>
@@ -43,6 +47,13 @@
 #include <apt-pkg/upgrade.h>
 #include <qdatetime.h>
 
+#include <algorithm>
+#include <limits>
+
+// System includes
+#include <sys/stat.h>
+#include <unistd.h>
+
 // Xapian includes
 #undef slots
 #include <xapian.h>
@@ -52,15 +63,36 @@
 #include "config.h" // krazy:exclude=includes
 #include "dbusinterfaces_p.h"
 #include "debfile.h"
+#include "depcacheoverlay.h"
 #include "transaction.h"
 
+// How long to wait for the worker to rebuild an out of date cache before
+// building it in memory instead
+#define REBUILD_CACHE_TIMEOUT 3000 // 3 seconds
+// Update phase hashes kept for packagesInUpdatePhase()
+#define MAX_UPDATE_PHASE_THRESHOLDS 16384
+
 namespace QApt {
 
+/**
+ * Shared between the backend and the simulations it started, so that
+ * simulations can tell whether the cache they were started on is still
+ * around. Holding the lock for reading keeps the cache from being reloaded.
+ */
+struct CacheGuard
+{
+    QReadWriteLock lock;
+    // Bumped on each cache reload, 0 once the backend is gone
+    quint64 generation = 1;
+};
+
 class BackendPrivate
 {
 public:
     BackendPrivate()
-        : cache(nullptr)
+        : markingGeneration(0)
+        , installCostsGeneration(0)
+        , cache(nullptr)
         , records(nullptr)
         , maxStackSize(20)
         , xapianDatabase(nullptr)
@@ -68,10 +100,16 @@ public:
         , config(nullptr)
         , actionGroup(nullptr)
         , frontendCaps(QApt::NoCaps)
+        , cacheGuard(new CacheGuard)
     {
     }
     ~BackendPrivate()
     {
+        {
+            QWriteLocker locker(&cacheGuard->lock);
+            cacheGuard->generation = 0;
+        }
+
         qDeleteAll(packages);
         delete cache;
         delete records;
@@ -86,6 +124,16 @@ public:
     QVector<int> packagesIndex;
     // Set of group names extracted from our packages
     QSet<Group> groups;
+    // Update phase thresholds keyed by "source-version-machineid". These only
+    // depend on the key, so they stay valid across cache reloads. Bounded by
+    // MAX_UPDATE_PHASE_THRESHOLDS
+    mutable QHash<QString, int> updatePhaseThresholds;
+    // Bumped by every change to the marking or the candidate versions
+    quint64 markingGeneration;
+    // Backend::installCosts() results by package ID, for the marking of
+    // installCostsGeneration
+    mutable QHash<int, SimulationResult> installCosts;
+    mutable quint64 installCostsGeneration;
     // Cache of origin/human-readable name pairings
     QHash<QString, QString> originMap;
     // Relation of an origin and its hostname
@@ -127,9 +175,22 @@ public:
 
     // Other
     bool writeSelectionFile(const QString &file, const QString &path) const;
+    bool isDiskCacheStale() const;
     QString customProxy;
     QString initErrorMessage;
     QApt::FrontendCaps frontendCaps;
+
+    // Transactions
+    QVariantMap changesList() const;
+    static QVariantMap packageList(const PackageList &packages, Package::State state);
+
+    // Simulation
+    QSharedPointer<CacheGuard> cacheGuard;
+    SimulationResult simulate(const QSharedPointer<const DepCacheOverlay::Snapshot> &snapshot,
+                              const PackageList &marked, Package::State action) const;
+    SimulationResult simulate(DepCacheOverlay &overlay,
+                              const QSharedPointer<const DepCacheOverlay::Snapshot> &snapshot,
+                              const PackageList &marked, Package::State action) const;
 };
 
 QDateTime BackendPrivate::getReleaseDateFromDistroInfo(const QString &releaseId, const QString &releaseCodename) const
@@ -207,6 +268,96 @@ bool BackendPrivate::writeSelectionFile(const QString &selectionDocument, const
     return true;
 }
 
+bool BackendPrivate::isDiskCacheStale() const
+{
+    const std::string cachePath = _config->FindFile("Dir::Cache::pkgcache");
+
+    // The cache isn't kept on disk at all
+    if (cachePath.empty())
+        return false;
+
+    struct stat cacheInfo;
+    if (stat(cachePath.c_str(), &cacheInfo) != 0)
+        return true;
+
+    // What the cache is built from. Files are replaced by renaming, which
+    // also changes the modification time of the directories they are in.
+    // APT leaves a cache that is still valid alone, so the worker touches
+    // it after checking, see AptWorker::markDiskCacheChecked()
+    const std::string sources[] = {
+        _config->FindFile("Dir::State::status"),
+        _config->FindDir("Dir::State::lists"),
+        _config->FindFile("Dir::Etc::sourcelist"),
+        _config->FindDir("Dir::Etc::sourceparts")
+    };
+
+    for (const std::string &source : sources) {
+        struct stat info;
+        if (source.empty() || stat(source.c_str(), &info) != 0)
+            continue;
+
+        if (info.st_mtim.tv_sec > cacheInfo.st_mtim.tv_sec ||
+            (info.st_mtim.tv_sec == cacheInfo.st_mtim.tv_sec &&
+             info.st_mtim.tv_nsec > cacheInfo.st_mtim.tv_nsec)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+SimulationResult BackendPrivate::simulate(const QSharedPointer<const DepCacheOverlay::Snapshot> &snapshot,
+                                          const PackageList &marked, Package::State action) const
+{
+    pkgDepCache *depCache = cache->depCache();
+
+    DepCacheOverlay overlay(&depCache->GetCache(), cache->policy());
+    if (!overlay.load(snapshot)) {
+        return SimulationResult();
+    }
+
+    return simulate(overlay, snapshot, marked, action);
+}
+
+SimulationResult BackendPrivate::simulate(DepCacheOverlay &overlay,
+                                          const QSharedPointer<const DepCacheOverlay::Snapshot> &snapshot,
+                                          const PackageList &marked, Package::State action) const
+{
+    {
+        pkgDepCache::ActionGroup group(overlay);
+        for (Package *package : marked) {
+            overlay.mark(package->packageIterator(), action);
+        }
+    }
+
+    StateChanges changes;
+    for (Package *package : packages) {
+        const pkgCache::PkgIterator &iter = package->packageIterator();
+
+        int status = DepCacheOverlay::packageState(overlay[iter]);
+        if (status == DepCacheOverlay::packageState(snapshot->packageStates[iter->ID])) {
+            continue;
+        }
+
+        // Reduce to a single flag, like Backend::stateChanges() does
+        status &= (Package::Held |
+                   Package::NewInstall |
+                   Package::ToReInstall |
+                   Package::ToUpgrade |
+                   Package::ToDowngrade |
+                   Package::ToRemove);
+
+        if (status) {
+            changes[(Package::State)status].append(package);
+        }
+    }
+
+    return SimulationResult(changes,
+                            qint64(overlay.DebSize()) - qint64(snapshot->downloadSize),
+                            overlay.UsrSize() - snapshot->usrSize,
+                            overlay.BrokenCount() > 0);
+}
+
 Backend::Backend(QObject *parent)
         : QObject(parent)
         , d_ptr(new BackendPrivate)
@@ -249,6 +400,22 @@ bool Backend::reloadCache()
 
     emit cacheReloadStarted();
 
+    // Only root can write an out of date cache to disk. Everybody else would
+    // build a private copy in memory each time. If the worker can't help,
+    // that's what happens below
+    if (geteuid() != 0 && d->isDiskCacheStale()) {
+        // The timeout only applies to calls made while it is set
+        const int timeout = d->worker->timeout();
+        d->worker->setTimeout(REBUILD_CACHE_TIMEOUT);
+        QDBusPendingReply<bool> rep = d->worker->rebuildCache();
+        d->worker->setTimeout(timeout);
+        rep.waitForFinished();
+    }
+
+    // Wait for running simulations, and invalidate queued ones
+    QWriteLocker locker(&d->cacheGuard->lock);
+    ++d->cacheGuard->generation;
+
     if (!d->cache->open()) {
         setInitError();
         return false;
@@ -266,6 +433,8 @@ bool Backend::reloadCache()
     d->siteMap.clear();
     d->packagesIndex.clear();
     d->installedCount = 0;
+    d->installCosts.clear();
+    markingChanged();
 
     int packageCount = depCache->Head().PackageCount;
     d->packagesIndex.resize(packageCount);
@@ -320,6 +489,8 @@ bool Backend::reloadCache()
 
     loadReleaseDate();
 
+    locker.unlock();
+
     emit cacheReloadFinished();
 
     return true;
@@ -616,6 +787,252 @@ PackageList Backend::upgradeablePackages() const
     return upgradeablePackages;
 }
 
+PackageList Backend::packagesInUpdatePhase(const PackageList &packages) const
+{
+    Q_D(const Backend);
+
+    struct PhaseCandidate {
+        Package *package;
+        pkgCache::VerIterator ver;
+        pkgCache::VerFileIterator verFile;
+        QString seedString;
+        int percentage;
+    };
+
+    QSet<Package *> inUpdatePhase;
+    QVector<PhaseCandidate> candidates;
+    candidates.reserve(packages.size());
+
+    pkgDepCache *depCache = d->cache->depCache();
+    for (Package *package : packages) {
+        if (!(package->state() & Package::Upgradeable)) {
+            continue;
+        }
+
+        // Known from an earlier call, or from Package::isInUpdatePhase()
+        bool isInUpdatePhase = false;
+        if (package->cachedUpdatePhase(&isInUpdatePhase)) {
+            if (isInUpdatePhase) {
+                inUpdatePhase.insert(package);
+            }
+            continue;
+        }
+
+        const pkgCache::VerIterator &ver = depCache->GetCandidateVersion(package->packageIterator());
+        if (ver.end()) {
+            continue;
+        }
+
+        candidates.append({ package, ver, ver.FileList(), QString(), 0 });
+    }
+
+    // Read the records in the order they appear in the index files, so that
+    // the record parser only ever seeks forwards.
+    std::sort(candidates.begin(), candidates.end(),
+              [](const PhaseCandidate &a, const PhaseCandidate &b) {
+        if (a.verFile.File()->ID != b.verFile.File()->ID) {
+            return a.verFile.File()->ID < b.verFile.File()->ID;
+        }
+        return a.verFile->Offset < b.verFile->Offset;
+    });
+
+    const QString machineId = Package::updatePhaseMachineId();
+    QStringList missingSeeds;
+
+    for (PhaseCandidate &candidate : candidates) {
+        pkgRecords::Parser &rec = d->records->Lookup(candidate.verFile);
+
+        bool intConversionOk = true;
+        const QString percentage = QString::fromStdString(rec.RecordField("Phased-Update-Percentage"));
+        candidate.percentage = percentage.toInt(&intConversionOk);
+
+        // Not phased at all
+        if (!intConversionOk) {
+            inUpdatePhase.insert(candidate.package);
+            candidate.package->setCachedUpdatePhase(true);
+            continue;
+        }
+
+        // No way to tell machines apart. Like Package::isInUpdatePhase(),
+        // don't remember this, the machine id may be there next time
+        if (machineId.isEmpty()) {
+            inUpdatePhase.insert(candidate.package);
+            continue;
+        }
+
+        QString sourcePackage = QString::fromStdString(rec.SourcePkg());
+        if (sourcePackage.isEmpty()) {
+            sourcePackage = candidate.package->name();
+        }
+
+        candidate.seedString = QStringLiteral("%1-%2-%3").arg(sourcePackage,
+                                                              QLatin1String(candidate.ver.VerStr()),
+                                                              machineId);
+
+        if (!d->updatePhaseThresholds.contains(candidate.seedString)) {
+            missingSeeds << candidate.seedString;
+        }
+    }
+
+    missingSeeds.removeDuplicates();
+    const QList<int> thresholds = QtConcurrent::blockingMapped<QList<int> >(missingSeeds,
+                                                                           Package::updatePhaseThreshold);
+
+    // Versions come and go over the lifetime of a backend, so don't let the
+    // hashes of old ones pile up
+    if (d->updatePhaseThresholds.size() + missingSeeds.size() > MAX_UPDATE_PHASE_THRESHOLDS) {
+        d->updatePhaseThresholds.clear();
+    }
+
+    for (int i = 0; i < missingSeeds.size(); ++i) {
+        d->updatePhaseThresholds.insert(missingSeeds.at(i), thresholds.at(i));
+    }
+
+    for (const PhaseCandidate &candidate : std::as_const(candidates)) {
+        if (candidate.seedString.isEmpty()) {
+            continue;
+        }
+
+        const bool isInUpdatePhase =
+                (d->updatePhaseThresholds.value(candidate.seedString) <= candidate.percentage);
+        candidate.package->setCachedUpdatePhase(isInUpdatePhase);
+        if (isInUpdatePhase) {
+            inUpdatePhase.insert(candidate.package);
+        }
+    }
+
+    // In the order of the input
+    PackageList result;
+    for (Package *package : packages) {
+        if (inUpdatePhase.contains(package)) {
+            result << package;
+        }
+    }
+
+    return result;
+}
+
+SimulationResult Backend::simulate(const PackageList &packages, Package::State action) const
+{
+    Q_D(const Backend);
+
+    return d->simulate(DepCacheOverlay::takeSnapshot(d->cache->depCache()), packages, action);
+}
+
+QFuture<SimulationResult> Backend::simulateAsync(const PackageList &packages, Package::State action,
+                                                 QThreadPool *pool) const
+{
+    Q_D(const Backend);
+
+    // The snapshot has to be taken here, the shared depCache may only be
+    // touched from our own thread
+    const QSharedPointer<const DepCacheOverlay::Snapshot> snapshot =
+            DepCacheOverlay::takeSnapshot(d->cache->depCache());
+    const QSharedPointer<CacheGuard> guard = d->cacheGuard;
+    const quint64 generation = guard->generation;
+
+    if (!pool) {
+        pool = QThreadPool::globalInstance();
+    }
+
+    return QtConcurrent::run(pool, [d, guard, generation, snapshot, packages, action]() {
+        QReadLocker locker(&guard->lock);
+        if (guard->generation != generation) {
+            return SimulationResult();
+        }
+
+        return d->simulate(snapshot, packages, action);
+    });
+}
+
+QHash<Package *, SimulationResult> Backend::installCosts(const PackageList &packages) const
+{
+    Q_D(const Backend);
+
+    QHash<Package *, SimulationResult> costs;
+    PackageList missing;
+
+    if (d->installCostsGeneration != d->markingGeneration) {
+        d->installCosts.clear();
+        d->installCostsGeneration = d->markingGeneration;
+    }
+
+    // While events are compressed the marking is in flux, so the results
+    // aren't worth keeping
+    const bool useCache = !d->actionGroup;
+
+    for (Package *package : packages) {
+        if (costs.contains(package)) {
+            continue;
+        }
+
+        const int id = package->packageIterator()->ID;
+        if (useCache && d->installCosts.contains(id)) {
+            costs.insert(package, d->installCosts.value(id));
+            continue;
+        }
+
+        // Installing an up to date package that stays installed is a no-op
+        const int state = package->state();
+        if ((state & Package::Installed) && !(state & (Package::Upgradeable | Package::ToRemove))) {
+            costs.insert(package, SimulationResult(StateChanges(), 0, 0, false));
+            continue;
+        }
+
+        costs.insert(package, SimulationResult());
+        missing.append(package);
+    }
+
+    if (!missing.isEmpty()) {
+        // Initializing an overlay costs about as much as a simulation, so
+        // each thread gets one overlay which it resets between packages
+        const int chunkCount = qBound(1, QThreadPool::globalInstance()->maxThreadCount(),
+                                      missing.size());
+        QList<PackageList> chunks(chunkCount);
+        for (int i = 0; i < missing.size(); ++i) {
+            chunks[i * chunkCount / missing.size()].append(missing.at(i));
+        }
+
+        const QSharedPointer<const DepCacheOverlay::Snapshot> snapshot =
+                DepCacheOverlay::takeSnapshot(d->cache->depCache());
+
+        const QList<QList<SimulationResult> > results =
+                QtConcurrent::blockingMapped<QList<QList<SimulationResult> > >(chunks,
+                [d, snapshot](const PackageList &chunk) {
+            QList<SimulationResult> chunkResults;
+            chunkResults.reserve(chunk.size());
+
+            DepCacheOverlay overlay(&d->cache->depCache()->GetCache(), d->cache->policy());
+            if (!overlay.load(snapshot)) {
+                chunkResults.resize(chunk.size());
+                return chunkResults;
+            }
+
+            for (Package *package : chunk) {
+                chunkResults.append(d->simulate(overlay, snapshot, PackageList() << package,
+                                                Package::ToInstall));
+                overlay.reset();
+            }
+
+            return chunkResults;
+        });
+
+        for (int i = 0; i < chunks.size(); ++i) {
+            for (int j = 0; j < chunks.at(i).size(); ++j) {
+                Package *package = chunks.at(i).at(j);
+                const SimulationResult &result = results.at(i).at(j);
+
+                costs.insert(package, result);
+                if (useCache && result.isValid()) {
+                    d->installCosts.insert(package->packageIterator()->ID, result);
+                }
+            }
+        }
+    }
+
+    return costs;
+}
+
 PackageList Backend::markedPackages() const
 {
     Q_D(const Backend);
@@ -962,6 +1379,7 @@ void Backend::restoreCacheState(const CacheState &state)
         deps->MarkAuto(pkg->packageIterator(), (oldflags & Package::IsAuto));
     }
 
+    markingChanged();
     emit packageChanged();
 }
 
@@ -1028,6 +1446,7 @@ void Backend::markPackagesForUpgrade()
     Q_D(Backend);
 
     APT::Upgrade::Upgrade(*d->cache->depCache(), APT::Upgrade::FORBID_REMOVE_PACKAGES | APT::Upgrade::FORBID_INSTALL_NEW_PACKAGES);
+    markingChanged();
     emit packageChanged();
 }
 
@@ -1036,6 +1455,7 @@ void Backend::markPackagesForDistUpgrade()
     Q_D(Backend);
 
     APT::Upgrade::Upgrade(*d->cache->depCache(), APT::Upgrade::ALLOW_EVERYTHING);
+    markingChanged();
     emit packageChanged();
 }
 
@@ -1057,6 +1477,7 @@ void Backend::markPackagesForAutoRemove()
             cache.MarkDelete(pkgIter, false);
     }
 
+    markingChanged();
     emit packageChanged();
 }
 
@@ -1085,52 +1506,38 @@ void Backend::markPackages(const QApt::PackageList &packages, QApt::Package::Sta
 
     foreach (Package *package, packages) {
         const pkgCache::PkgIterator &iter = package->packageIterator();
+        // The same rules as for simulations, see DepCacheOverlay::mark()
+        if (!DepCacheOverlay::isMarkable(*deps, iter, action)) {
+            continue;
+        }
+
         switch (action) {
-        case Package::ToInstall: {
-            int state = package->staticState();
-            // Mark for install if not already installed, or if upgradeable
-            if (!(state & Package::Installed) || (state & Package::Upgradeable)) {
-                package->setInstall();
-            }
+        case Package::ToInstall:
+            package->setInstall();
             break;
-        }
         case Package::ToRemove:
-            if (package->isInstalled()) {
-                package->setRemove();
-            }
+            package->setRemove();
             break;
-        case Package::ToUpgrade: {
-            bool fromUser = !(package->state() & Package::IsAuto);
-            deps->MarkInstall(iter, true, 0, fromUser);
+        case Package::ToUpgrade:
+            DepCacheOverlay::mark(*deps, iter, action);
+            markingChanged();
             break;
-        }
-        case Package::ToReInstall: {
-            int state = package->staticState();
-
-            if(state & Package::Installed
-               && !(state & Package::NotDownloadable)
-               && !(state & Package::Upgradeable)) {
-                package->setReInstall();
-            }
+        case Package::ToReInstall:
+            package->setReInstall();
             break;
-        }
         case Package::ToKeep:
             package->setKeep();
             break;
-        case Package::ToPurge: {
-            int state = package->staticState();
-
-            if ((state & Package::Installed) || (state & Package::ResidualConfig)) {
-                package->setPurge();
-            }
+        case Package::ToPurge:
+            package->setPurge();
             break;
-        }
         default:
             break;
         }
     }
 
     setCompressEvents(false);
+    markingChanged();
     emit packageChanged();
 }
 
@@ -1152,12 +1559,10 @@ void Backend::setCompressEvents(bool enabled)
     }
 }
 
-QApt::Transaction * Backend::commitChanges()
+QVariantMap BackendPrivate::changesList() const
 {
-    Q_D(Backend);
-
     QVariantMap packageList;
-    for (const Package *package : d->packages) {
+    for (const Package *package : packages) {
         int flags = package->state();
         std::string fullName = package->packageIterator().FullName();
         // Cannot have any of these flags simultaneously
@@ -1195,23 +1600,68 @@ QApt::Transaction * Backend::commitChanges()
         }
     }
 
-    QDBusPendingReply<QString> rep = d->worker->commitChanges(packageList);
+    return packageList;
+}
+
+QVariantMap BackendPrivate::packageList(const PackageList &packages, Package::State state)
+{
+    QVariantMap packageList;
+
+    for (const Package *package : packages) {
+        std::string fullName = package->packageIterator().FullName();
+        packageList.insert(QString::fromStdString(fullName), state);
+    }
+
+    return packageList;
+}
+
+Transaction *Backend::startTransaction(TransactionRole role, const QVariantMap &instructionsList,
+                                       const QVariantMap &properties)
+{
+    Q_D(Backend);
+
+    QVariantMap setup = properties;
+    if (!setup.contains(QLatin1String("frontendCaps")))
+        setup.insert(QLatin1String("frontendCaps"), (int)d->frontendCaps);
+
+    // The worker only replies once polkit is done, which takes as long as the
+    // user needs for the password dialog. Giving up before would leave a
+    // transaction running that nobody can track or cancel
+    const int timeout = d->worker->timeout();
+    d->worker->setTimeout(std::numeric_limits<int>::max());
+    QDBusPendingReply<QVariantMap> rep = d->worker->startTransaction(role, instructionsList, setup);
+    d->worker->setTimeout(timeout);
+    rep.waitForFinished();
+
+    if (rep.isError())
+        return nullptr;
+
+    return new Transaction(rep.value());
+}
+
+QApt::Transaction * Backend::commitChanges()
+{
+    Q_D(Backend);
+
+    QDBusPendingReply<QString> rep = d->worker->commitChanges(d->changesList());
     Transaction *trans = new Transaction(rep.value());
     trans->setFrontendCaps(d->frontendCaps);
 
     return trans;
 }
 
-QApt::Transaction * Backend::installPackages(PackageList packages)
+QApt::Transaction *Backend::commitChanges(const QVariantMap &properties)
 {
     Q_D(Backend);
 
-    QVariantMap packageList;
+    return startTransaction(CommitChangesRole, d->changesList(), properties);
+}
 
-    for (const Package *package : packages) {
-        std::string fullName = package->packageIterator().FullName();
-        packageList.insert(QString::fromStdString(fullName), Package::ToInstall);
-    }
+QApt::Transaction * Backend::installPackages(PackageList packages)
+{
+    Q_D(Backend);
+
+    QVariantMap packageList = BackendPrivate::packageList(packages, Package::ToInstall);
 
     QDBusPendingReply<QString> rep = d->worker->commitChanges(packageList);
     Transaction *trans = new Transaction(rep.value());
@@ -1220,16 +1670,18 @@ QApt::Transaction * Backend::installPackages(PackageList packages)
     return trans;
 }
 
+QApt::Transaction *Backend::installPackages(const PackageList &packages, const QVariantMap &properties)
+{
+    return startTransaction(CommitChangesRole,
+                            BackendPrivate::packageList(packages, Package::ToInstall),
+                            properties);
+}
+
 QApt::Transaction * Backend::removePackages(PackageList packages)
 {
     Q_D(Backend);
 
-    QVariantMap packageList;
-
-    for (const Package *package : packages) {
-        std::string fullName = package->packageIterator().FullName();
-        packageList.insert(QString::fromStdString(fullName), Package::ToRemove);
-    }
+    QVariantMap packageList = BackendPrivate::packageList(packages, Package::ToRemove);
 
     QDBusPendingReply<QString> rep = d->worker->commitChanges(packageList);
     Transaction *trans = new Transaction(rep.value());
@@ -1238,6 +1690,13 @@ QApt::Transaction * Backend::removePackages(PackageList packages)
     return trans;
 }
 
+QApt::Transaction *Backend::removePackages(const PackageList &packages, const QVariantMap &properties)
+{
+    return startTransaction(CommitChangesRole,
+                            BackendPrivate::packageList(packages, Package::ToRemove),
+                            properties);
+}
+
 Transaction *Backend::downloadArchives(const QString &listFile, const QString &destination)
 {
     Q_D(Backend);
@@ -1286,6 +1745,14 @@ Transaction *Backend::installFile(const DebFile &debFile)
     return trans;
 }
 
+Transaction *Backend::installFile(const DebFile &debFile, const QVariantMap &properties)
+{
+    QVariantMap setup = properties;
+    setup.insert(QLatin1String("filePath"), debFile.filePath());
+
+    return startTransaction(InstallFileRole, QVariantMap(), setup);
+}
+
 void Backend::emitPackageChanged()
 {
     emit packageChanged();
@@ -1302,6 +1769,16 @@ Transaction *Backend::updateCache()
     return trans;
 }
 
+Transaction *Backend::updateCache(const QVariantMap &properties)
+{
+    return startTransaction(UpdateCacheRole, QVariantMap(), properties);
+}
+
+Transaction *Backend::rebuildCache(const QVariantMap &properties)
+{
+    return startTransaction(RebuildCacheRole, QVariantMap(), properties);
+}
+
 Transaction *Backend::upgradeSystem(UpgradeType upgradeType)
 {
     Q_D(Backend);
@@ -1314,6 +1791,14 @@ Transaction *Backend::upgradeSystem(UpgradeType upgradeType)
     return trans;
 }
 
+Transaction *Backend::upgradeSystem(UpgradeType upgradeType, const QVariantMap &properties)
+{
+    QVariantMap setup = properties;
+    setup.insert(QLatin1String("safeUpgrade"), upgradeType == QApt::SafeUpgrade);
+
+    return startTransaction(UpgradeSystemRole, QVariantMap(), setup);
+}
+
 bool Backend::saveInstalledPackagesList(const QString &path) const
 {
     Q_D(const Backend);
@@ -1445,6 +1930,7 @@ bool Backend::loadSelections(const QString &path)
 
     Fix.Resolve(true);
 
+    markingChanged();
     emit packageChanged();
 
     return true;
@@ -1586,6 +2072,13 @@ void Backend::updateXapianIndex()
     emit xapianUpdateStarted();
 }
 
+void Backend::markingChanged()
+{
+    Q_D(Backend);
+
+    ++d->markingGeneration;
+}
+
 void Backend::emitXapianUpdateFinished()
 {
     QDBusConnection::systemBus().disconnect(QLatin1String("org.debian.AptXapianIndex"),
@@ -21,13 +21,16 @@
 #ifndef QAPT_BACKEND_H
 #define QAPT_BACKEND_H
 
+#include <QFuture>
 #include <QHash>
 #include <QStringList>
 #include <QVariantMap>
 
 #include "globals.h"
 #include "package.h"
+#include "simulationresult.h"
 
+class QThreadPool;
 class pkgSourceList;
 class pkgRecords;
 
@@ -148,6 +151,10 @@ public:
      * Mostly used internally, like after an update or a package installation
      * or removal.
      *
+     * If the package cache on disk is out of date and the process can't
+     * write it, the worker is asked to rebuild it first, instead of
+     * building it in memory. This blocks until the worker is done.
+     *
      * @return @c true when the cache reloads successfully. If it returns false,
      * assume that you cannot call any methods other than initErrorMessage()
      * safely.
@@ -348,6 +355,83 @@ public:
      */
     PackageList upgradeablePackages() const;
 
+    /**
+     * Returns the packages out of @p packages whose candidate version is in
+     * the update phase for this machine, as described by
+     * Package::isInUpdatePhase().
+     *
+     * This is considerably cheaper than calling Package::isInUpdatePhase() on
+     * each package, since the package records are read in a single pass in
+     * on-disk order and the phasing hashes are calculated in parallel. The
+     * hash results are kept across cache reloads. The results are also
+     * remembered by each package for Package::isInUpdatePhase().
+     *
+     * @param packages The packages to check, e.g. upgradeablePackages()
+     *
+     * \return A @c PackageList of the packages that are in the update phase,
+     * in the order of @p packages
+     *
+     * @since 6.0
+     */
+    PackageList packagesInUpdatePhase(const PackageList &packages) const;
+
+    /**
+     * Calculates what marking @p packages with @p action would do, on top of
+     * the current marking state, without changing it. The marking is carried
+     * out the same way as markPackages() does it, but in a private copy of
+     * the marking state, so packageChanged() is not emitted and the undo
+     * stack is not touched.
+     *
+     * Useful e.g. for showing "installing X would pull in N packages".
+     *
+     * @param packages The packages to mark
+     * @param action The state to mark the packages with
+     *
+     * \return The changes the marking would cause
+     *
+     * @see simulateAsync()
+     * @since 6.0
+     */
+    SimulationResult simulate(const PackageList &packages, Package::State action) const;
+
+    /**
+     * Like simulate(), but carries out the simulation in a thread pool.
+     * Any number of simulations may run at the same time, while the backend
+     * continues to be used from its own thread. The simulation works on the
+     * marking state at the time of the call.
+     *
+     * If the cache is reloaded before the simulation gets to run, an invalid
+     * SimulationResult is returned. Cache reloads wait for running
+     * simulations to finish.
+     *
+     * @param packages The packages to mark
+     * @param action The state to mark the packages with
+     * @param pool The thread pool to run in, or @c nullptr for the global
+     *             thread pool
+     *
+     * @since 6.0
+     */
+    QFuture<SimulationResult> simulateAsync(const PackageList &packages, Package::State action,
+                                            QThreadPool *pool = nullptr) const;
+
+    /**
+     * Estimates what installing each of the given packages would cost on
+     * top of the current marking state, e.g. for showing download sizes and
+     * additional dependencies in a catalog view. Every package is simulated
+     * on its own, and the simulations are spread over the global thread pool.
+     *
+     * Results are cached until the marking state changes or the cache is
+     * reloaded, so repeated calls for the same packages are cheap.
+     *
+     * @param packages The packages to estimate the install costs of
+     *
+     * \return The result of simulating installation of each package
+     *
+     * @see simulate()
+     * @since 6.0
+     */
+    QHash<Package *, SimulationResult> installCosts(const PackageList &packages) const;
+
     /**
      * Returns a list of all packages that have been marked for change. (To be
      * installed, removed, etc)
@@ -462,7 +546,15 @@ private:
 
     Package *package(pkgCache::PkgIterator &iter) const;
 
+    /**
+     * Invalidates what was computed for the previous marking. Called by
+     * everything that marks packages or changes candidate versions.
+     */
+    void markingChanged();
+
     void setInitError();
+    Transaction *startTransaction(QApt::TransactionRole role, const QVariantMap &instructionsList,
+                                  const QVariantMap &properties);
     void loadPackagePins();
     void loadReleaseDate();
 
@@ -627,6 +719,31 @@ public Q_SLOTS:
      */
     QApt::Transaction *commitChanges();
 
+    /**
+     * Starts and runs a transaction which will commit all pending package
+     * state changes that have been made to the backend.
+     *
+     * The transaction is created, set up with @p properties and run with a
+     * single call to the worker, instead of one call for each property and
+     * another to run it. Recognized properties are "locale", "proxy",
+     * "debconfPipe", "frontendCaps", "updateInterval", "priority",
+     * "streamingInstall", "coalescable", "queueMode", "maxParallelDownloads",
+     * "pipelineDepth", "downloadRetries" and "downloadLimit", named like the
+     * properties of QApt::Transaction. The frontend capabilities set with
+     * setFrontendCaps() are used unless given.
+     *
+     * This is a blocking call to the worker, which includes authorization.
+     *
+     * @param properties The properties to set up the transaction with
+     *
+     * @return A pointer to a @c Transaction object tracking the commit, or
+     * @c nullptr if the transaction could not be started, e.g. because
+     * authorization failed or a property is invalid
+     *
+     * @since 6.0
+     */
+    QApt::Transaction *commitChanges(const QVariantMap &properties);
+
     /**
      * Starts a transaction which will install the list of provided packages.
      * This function is useful when you only need a few packages installed and
@@ -642,6 +759,19 @@ public Q_SLOTS:
      */
     QApt::Transaction *installPackages(QApt::PackageList packages);
 
+    /**
+     * Starts and runs a transaction which will install the list of provided
+     * packages, set up with @p properties in the same call.
+     *
+     * @return A pointer to a @c Transaction object tracking the install, or
+     * @c nullptr if the transaction could not be started
+     *
+     * @since 6.0
+     * @see commitChanges(const QVariantMap &)
+     */
+    QApt::Transaction *installPackages(const QApt::PackageList &packages,
+                                       const QVariantMap &properties);
+
     /**
      * Starts a transaction which will remove the list of provided packages.
      * This function is useful when you only need a few packages removed and
@@ -657,6 +787,19 @@ public Q_SLOTS:
      */
     QApt::Transaction *removePackages(QApt::PackageList packages);
 
+    /**
+     * Starts and runs a transaction which will remove the list of provided
+     * packages, set up with @p properties in the same call.
+     *
+     * @return A pointer to a @c Transaction object tracking the removal, or
+     * @c nullptr if the transaction could not be started
+     *
+     * @since 6.0
+     * @see commitChanges(const QVariantMap &)
+     */
+    QApt::Transaction *removePackages(const QApt::PackageList &packages,
+                                      const QVariantMap &properties);
+
    /**
     * Downloads the packages listed in the provided list file to the provided
     * destination directory.
@@ -692,6 +835,18 @@ public Q_SLOTS:
     */
     Transaction *installFile(const DebFile &file);
 
+    /**
+     * Starts and runs a transaction which will install a .deb package
+     * archive file, set up with @p properties in the same call.
+     *
+     * @return A pointer to a @c Transaction object tracking the install, or
+     * @c nullptr if the transaction could not be started
+     *
+     * @since 6.0
+     * @see commitChanges(const QVariantMap &)
+     */
+    Transaction *installFile(const DebFile &file, const QVariantMap &properties);
+
     /**
      * Starts a transaction that will check for and downloads new package
      * source lists. (Essentially, checking for updates.)
@@ -702,6 +857,35 @@ public Q_SLOTS:
      */
     Transaction *updateCache();
 
+    /**
+     * Starts and runs a transaction that will check for new package source
+     * lists, set up with @p properties in the same call.
+     *
+     * @return A pointer to a @c Transaction object tracking the cache
+     * update, or @c nullptr if the transaction could not be started
+     *
+     * @since 6.0
+     * @see commitChanges(const QVariantMap &)
+     */
+    Transaction *updateCache(const QVariantMap &properties);
+
+    /**
+     * Starts and runs a transaction that will bring the package cache on
+     * disk (pkgcache.bin and srcpkgcache.bin) up to date. Processes that
+     * can't write the cache to disk otherwise build it in memory each time
+     * they open it while it is out of date. No authorization is needed.
+     *
+     * reloadCache() does this on its own when it finds the cache on disk
+     * out of date.
+     *
+     * @return A pointer to a @c Transaction object tracking the rebuild, or
+     * @c nullptr if the transaction could not be started
+     *
+     * @since 6.0
+     * @see commitChanges(const QVariantMap &)
+     */
+    Transaction *rebuildCache(const QVariantMap &properties = QVariantMap());
+
     /**
      * Starts a transaction which will upgrade as many of the packages as it can.
      * If the upgrade type is a "safe" upgrade, only packages that can be upgraded
@@ -717,6 +901,18 @@ public Q_SLOTS:
      */
     Transaction *upgradeSystem(QApt::UpgradeType upgradeType);
 
+    /**
+     * Starts and runs a transaction which will upgrade as many of the
+     * packages as it can, set up with @p properties in the same call.
+     *
+     * @return A pointer to a @c Transaction object tracking the upgrade, or
+     * @c nullptr if the transaction could not be started
+     *
+     * @since 6.0
+     * @see commitChanges(const QVariantMap &)
+     */
+    Transaction *upgradeSystem(QApt::UpgradeType upgradeType, const QVariantMap &properties);
+
     /**
      * Exports a list of all packages currently installed on the system. This
      * list can be read by the readSelections() function or by Synaptic.
@@ -83,6 +83,13 @@ pkgSourceList *Cache::list() const
     return d->cache->GetSourceList();
 }
 
+pkgPolicy *Cache::policy() const
+{
+    Q_D(const Cache);
+
+    return d->cache->GetPolicy();
+}
+
 QHash<pkgCache::PkgFileIterator, pkgIndexFile*> *Cache::trustCache() const
 {
     Q_D(const Cache);
@@ -28,6 +28,7 @@
 
 class pkgDepCache;
 class pkgIndexFile;
+class pkgPolicy;
 class pkgSourceList;
 
 namespace QApt {
@@ -68,6 +69,9 @@ public:
     /// Returns a pointer to the interal package source list.
     pkgSourceList *list() const;
 
+    /// Returns a pointer to the pinning policy used by the dependency cache.
+    pkgPolicy *policy() const;
+
    /**
     * Returns a pointer to QApt's cache of trusted package source index
     * files. These are used by QApt::Package to determine whether or not
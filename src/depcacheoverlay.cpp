@@ -0,0 +1,207 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "depcacheoverlay.h"
+
+// Apt includes
+#include <apt-pkg/algorithms.h>
+
+#include <algorithm>
+
+namespace QApt {
+
+QSharedPointer<const DepCacheOverlay::Snapshot> DepCacheOverlay::takeSnapshot(pkgDepCache *cache)
+{
+    QSharedPointer<Snapshot> snapshot(new Snapshot);
+
+    snapshot->packageStates.resize(cache->Head().PackageCount);
+    snapshot->dependencyStates.resize(cache->Head().DependsCount);
+
+    for (pkgCache::PkgIterator pkg = cache->PkgBegin(); !pkg.end(); ++pkg) {
+        snapshot->packageStates[pkg->ID] = (*cache)[pkg];
+
+        for (pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver) {
+            for (pkgCache::DepIterator dep = ver.DependsList(); !dep.end(); ++dep) {
+                snapshot->dependencyStates[dep->ID] = (*cache)[dep];
+            }
+        }
+    }
+
+    snapshot->usrSize = cache->UsrSize();
+    snapshot->downloadSize = cache->DebSize();
+    snapshot->installCount = cache->InstCount();
+    snapshot->deleteCount = cache->DelCount();
+    snapshot->keepCount = cache->KeepCount();
+    snapshot->brokenCount = cache->BrokenCount();
+    snapshot->policyBrokenCount = cache->PolicyBrokenCount();
+    snapshot->badCount = cache->BadCount();
+
+    return snapshot;
+}
+
+int DepCacheOverlay::packageState(const StateCache &state)
+{
+    int packageState = 0;
+
+    if (state.Install()) {
+        packageState |= Package::ToInstall;
+    }
+
+    if (state.iFlags & ReInstall) {
+        packageState |= Package::ToReInstall;
+    } else if (state.NewInstall()) {
+        packageState |= Package::NewInstall;
+    } else if (state.Upgrade()) {
+        packageState |= Package::ToUpgrade;
+    } else if (state.Downgrade()) {
+        packageState |= Package::ToDowngrade;
+    } else if (state.Delete()) {
+        packageState |= Package::ToRemove;
+        if (state.iFlags & Purge) {
+            packageState |= Package::ToPurge;
+        }
+    } else if (state.Keep()) {
+        packageState |= Package::ToKeep;
+        if (state.Held()) {
+            packageState |= Package::Held;
+        }
+    }
+
+    return packageState;
+}
+
+DepCacheOverlay::DepCacheOverlay(pkgCache *cache, Policy *policy)
+    : pkgDepCache(cache, policy)
+{
+}
+
+bool DepCacheOverlay::load(const QSharedPointer<const Snapshot> &snapshot)
+{
+    if (!Init(nullptr)) {
+        return false;
+    }
+
+    if (snapshot->packageStates.size() != Head().PackageCount ||
+        snapshot->dependencyStates.size() != Head().DependsCount) {
+        return false;
+    }
+
+    m_snapshot = snapshot;
+    reset();
+
+    return true;
+}
+
+void DepCacheOverlay::reset()
+{
+    std::copy(m_snapshot->packageStates.begin(), m_snapshot->packageStates.end(), PkgState);
+    std::copy(m_snapshot->dependencyStates.begin(), m_snapshot->dependencyStates.end(), DepState);
+
+    iUsrSize = m_snapshot->usrSize;
+    iDownloadSize = m_snapshot->downloadSize;
+    iInstCount = m_snapshot->installCount;
+    iDelCount = m_snapshot->deleteCount;
+    iKeepCount = m_snapshot->keepCount;
+    iBrokenCount = m_snapshot->brokenCount;
+    iPolicyBrokenCount = m_snapshot->policyBrokenCount;
+    iBadCount = m_snapshot->badCount;
+}
+
+bool DepCacheOverlay::isMarkable(pkgDepCache &cache, const PkgIterator &package,
+                                 Package::State action)
+{
+    StateCache &state = cache[package];
+    const bool installed = !package.CurrentVer().end();
+
+    switch (action) {
+    case Package::ToInstall:
+        // Not if already installed, unless upgradeable
+        return !installed || state.Upgradable();
+    case Package::ToRemove:
+        return installed;
+    case Package::ToPurge:
+        return installed || package->CurrentState == pkgCache::State::ConfigFiles;
+    case Package::ToReInstall:
+        return installed && !state.Upgradable() &&
+               state.CandidateVer && state.CandidateVerIter(cache).Downloadable();
+    case Package::ToUpgrade:
+    case Package::ToKeep:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void DepCacheOverlay::mark(pkgDepCache &cache, const PkgIterator &package, Package::State action)
+{
+    StateCache &state = cache[package];
+
+    switch (action) {
+    case Package::ToInstall:
+        cache.MarkInstall(package, true);
+
+        // If something is wrong, try to fix it
+        if (!state.Install() || cache.BrokenCount() > 0) {
+            pkgProblemResolver fix(&cache);
+            fix.Clear(package);
+            fix.Protect(package);
+            fix.Resolve(true);
+        }
+        break;
+    case Package::ToRemove:
+    case Package::ToPurge: {
+        pkgProblemResolver fix(&cache);
+        fix.Clear(package);
+        fix.Protect(package);
+        fix.Remove(package);
+
+        cache.SetReInstall(package, false);
+        cache.MarkDelete(package, action == Package::ToPurge);
+
+        fix.Resolve(true);
+        break;
+    }
+    case Package::ToUpgrade:
+        cache.MarkInstall(package, true, 0, !(state.Flags & pkgCache::Flag::Auto));
+        break;
+    case Package::ToReInstall:
+        cache.SetReInstall(package, true);
+        break;
+    case Package::ToKeep:
+        cache.MarkKeep(package, false);
+        cache.SetReInstall(package, false);
+        if (cache.BrokenCount() > 0) {
+            pkgProblemResolver fix(&cache);
+            fix.ResolveByKeep();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void DepCacheOverlay::mark(const PkgIterator &package, Package::State action)
+{
+    if (isMarkable(*this, package, action)) {
+        mark(*this, package, action);
+    }
+}
+
+}
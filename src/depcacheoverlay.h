@@ -0,0 +1,116 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef QAPT_DEPCACHEOVERLAY_H
+#define QAPT_DEPCACHEOVERLAY_H
+
+#include <QSharedPointer>
+
+#include <apt-pkg/depcache.h>
+
+#include <vector>
+
+#include "package.h"
+
+namespace QApt {
+
+/**
+ * The DepCacheOverlay class is a private dependency cache on top of the
+ * package cache of another pkgDepCache. It starts out with a copy of the
+ * marking state of that cache, so marking packages in the overlay shows what
+ * would happen to the user's selection without touching it.
+ *
+ * Overlays only read the shared pkgCache and policy, so several of them
+ * may be used concurrently from different threads.
+ *
+ * @author The LingmoOS Developers
+ */
+class DepCacheOverlay : public pkgDepCache
+{
+public:
+    /**
+     * A frozen copy of the marking state of a dependency cache.
+     */
+    struct Snapshot
+    {
+        std::vector<StateCache> packageStates;
+        std::vector<unsigned char> dependencyStates;
+        signed long long usrSize;
+        unsigned long long downloadSize;
+        unsigned long installCount;
+        unsigned long deleteCount;
+        unsigned long keepCount;
+        unsigned long brokenCount;
+        unsigned long policyBrokenCount;
+        unsigned long badCount;
+    };
+
+    /**
+     * Copies the marking state of @p cache. This only uses the public
+     * interface of @p cache and has to happen in the thread owning it.
+     */
+    static QSharedPointer<const Snapshot> takeSnapshot(pkgDepCache *cache);
+
+    /**
+     * Returns the mutable QApt::Package::State flags for a package state,
+     * as reported by Package::state(), without the IsAuto flag.
+     */
+    static int packageState(const StateCache &state);
+
+    /**
+     * Returns whether Backend::markPackages() marks @p package of @p cache
+     * with @p action, e.g. not installing what is installed and up to date.
+     */
+    static bool isMarkable(pkgDepCache &cache, const PkgIterator &package,
+                           Package::State action);
+
+    /**
+     * Marks @p package of @p cache with @p action, resolving what breaks,
+     * the way the marking functions of QApt::Package do.
+     */
+    static void mark(pkgDepCache &cache, const PkgIterator &package, Package::State action);
+
+    DepCacheOverlay(pkgCache *cache, Policy *policy);
+
+    /**
+     * Initializes the overlay and replaces its marking state with
+     * @p snapshot.
+     *
+     * @return @c false if the overlay could not be initialized
+     */
+    bool load(const QSharedPointer<const Snapshot> &snapshot);
+
+    /**
+     * Drops all marking done since load().
+     */
+    void reset();
+
+    /**
+     * Marks @p package with @p action the way Backend::markPackages() does.
+     */
+    void mark(const PkgIterator &package, Package::State action);
+
+private:
+    QSharedPointer<const Snapshot> m_snapshot;
+};
+
+}
+
+#endif
@@ -0,0 +1,203 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "dependencyview.h"
+
+#include <cstring>
+
+namespace QApt {
+
+DependencyView::Alternative::Alternative(const pkgCache::DepIterator &dep)
+    : m_dep(dep)
+{
+}
+
+QLatin1String DependencyView::Alternative::packageName() const
+{
+    return QLatin1String(m_dep.TargetPkg().Name());
+}
+
+QLatin1String DependencyView::Alternative::packageVersion() const
+{
+    return QLatin1String(m_dep.TargetVer());
+}
+
+QLatin1String DependencyView::Alternative::multiArchAnnotation() const
+{
+    // The cache resolves unannotated dependencies to the architecture of
+    // the depending package, so only a differing target architecture
+    // corresponds to an annotation in the control field
+    const char *targetArch = m_dep.TargetPkg().Arch();
+    const char *parentArch = m_dep.ParentPkg().Arch();
+
+    if (!targetArch || (parentArch && strcmp(targetArch, parentArch) == 0)) {
+        return QLatin1String();
+    }
+
+    return QLatin1String(targetArch);
+}
+
+RelationType DependencyView::Alternative::relationType() const
+{
+    // The lower nibble holds the comparison, the upper bits are flags
+    return (RelationType)(m_dep->CompareOp & 0x0F);
+}
+
+DependencyType DependencyView::Alternative::dependencyType() const
+{
+    return (DependencyType)m_dep->Type;
+}
+
+bool DependencyView::Alternative::isOrDependency() const
+{
+    return (m_dep->CompareOp & pkgCache::Dep::Or) == pkgCache::Dep::Or;
+}
+
+DependencyInfo DependencyView::Alternative::toDependencyInfo() const
+{
+    return DependencyView::dependencyInfo(*this);
+}
+
+const pkgCache::DepIterator &DependencyView::Alternative::dependencyIterator() const
+{
+    return m_dep;
+}
+
+DependencyView::const_iterator::const_iterator()
+    : m_type(InvalidType)
+{
+}
+
+DependencyView::const_iterator::const_iterator(const pkgCache::DepIterator &dep, DependencyType type)
+    : m_dep(dep)
+    , m_type(type)
+{
+    skipFiltered();
+}
+
+void DependencyView::const_iterator::skipFiltered()
+{
+    // Implicit dependencies are generated by APT for Multi-Arch and never
+    // appear in a control field
+    while (!m_dep.end() &&
+           ((m_type != InvalidType && m_dep->Type != m_type) || m_dep.IsImplicit())) {
+        ++m_dep;
+    }
+}
+
+DependencyView::Alternative DependencyView::const_iterator::operator*() const
+{
+    return Alternative(m_dep);
+}
+
+DependencyView::const_iterator &DependencyView::const_iterator::operator++()
+{
+    ++m_dep;
+    skipFiltered();
+
+    return *this;
+}
+
+bool DependencyView::const_iterator::operator==(const const_iterator &other) const
+{
+    if (m_dep.end() || other.m_dep.end()) {
+        return m_dep.end() == other.m_dep.end();
+    }
+
+    return m_dep == other.m_dep;
+}
+
+bool DependencyView::const_iterator::operator!=(const const_iterator &other) const
+{
+    return !(*this == other);
+}
+
+DependencyView::DependencyView()
+    : m_type(InvalidType)
+{
+}
+
+DependencyView::DependencyView(const pkgCache::VerIterator &ver, DependencyType type)
+    : m_version(ver)
+    , m_type(type)
+{
+}
+
+DependencyView::const_iterator DependencyView::begin() const
+{
+    if (m_version.end()) {
+        return const_iterator();
+    }
+
+    return const_iterator(m_version.DependsList(), m_type);
+}
+
+DependencyView::const_iterator DependencyView::end() const
+{
+    return const_iterator();
+}
+
+bool DependencyView::isEmpty() const
+{
+    return begin() == end();
+}
+
+DependencyType DependencyView::dependencyType() const
+{
+    return m_type;
+}
+
+QList<DependencyItem> DependencyView::toDependencyItems() const
+{
+    QList<DependencyItem> items;
+    DependencyItem item;
+
+    for (const Alternative &alternative : *this) {
+        item.append(dependencyInfo(alternative));
+
+        if (!alternative.isOrDependency()) {
+            items.append(item);
+            item.clear();
+        }
+    }
+
+    // Only a broken cache would end on an "or"
+    if (!item.isEmpty()) {
+        items.append(item);
+    }
+
+    return items;
+}
+
+DependencyInfo DependencyView::dependencyInfo(const Alternative &alternative)
+{
+    QString package = alternative.packageName();
+    const QLatin1String annotation = alternative.multiArchAnnotation();
+    if (!annotation.isEmpty()) {
+        package += QLatin1Char(':') + annotation;
+    }
+
+    return DependencyInfo(package,
+                          alternative.packageVersion(),
+                          alternative.relationType(),
+                          alternative.dependencyType());
+}
+
+}
@@ -0,0 +1,164 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef QAPT_DEPENDENCYVIEW_H
+#define QAPT_DEPENDENCYVIEW_H
+
+#include <QLatin1String>
+#include <QList>
+
+#include <apt-pkg/pkgcache.h>
+
+#include "dependencyinfo.h"
+#include "globals.h"
+
+namespace QApt {
+
+/**
+ * The DependencyView class is a lightweight, read-only view of the
+ * dependency relations of a package version, read straight from the APT
+ * binary cache.
+ *
+ * Unlike the DependencyItem lists returned by Package::depends() and friends,
+ * iterating over a view does not allocate any memory. All strings returned
+ * point directly into the cache. A view iterates over single alternatives;
+ * the alternatives of an "or" group follow each other, and all but the last
+ * alternative of a group return @c true for Alternative::isOrDependency().
+ *
+ * @code
+ * for (const QApt::DependencyView::Alternative &dep : package->dependencyView(QApt::Depends)) {
+ *     if (dep.packageName() == QLatin1String("libc6"))
+ *         ...
+ * }
+ * @endcode
+ *
+ * @warning A view, and anything obtained from it, is only valid until the
+ *          next cache reload.
+ *
+ * @since 6.0
+ */
+class Q_DECL_EXPORT DependencyView
+{
+public:
+    /**
+     * A single alternative of a dependency.
+     */
+    class Q_DECL_EXPORT Alternative
+    {
+    public:
+        /// The name of the package that the dependency describes.
+        QLatin1String packageName() const;
+
+        /// The version of the package that the dependency describes, if any.
+        QLatin1String packageVersion() const;
+
+        /**
+         * The multi-arch annotation of the dependency, e.g. "any" or a
+         * specific architecture. Empty if the dependency is resolved within
+         * the architecture of the depending package.
+         */
+        QLatin1String multiArchAnnotation() const;
+
+        /// The logical relation in regards to the version
+        RelationType relationType() const;
+
+        /// The type of the dependency, such as "Depends" or "Recommends"
+        DependencyType dependencyType() const;
+
+        /// Whether another alternative of the same "or" group follows
+        bool isOrDependency() const;
+
+        /// Returns an allocated DependencyInfo copy of this alternative
+        DependencyInfo toDependencyInfo() const;
+
+        /// Returns the internal APT representation of the dependency
+        const pkgCache::DepIterator &dependencyIterator() const;
+
+    private:
+        explicit Alternative(const pkgCache::DepIterator &dep);
+
+        pkgCache::DepIterator m_dep;
+
+        friend class DependencyView;
+    };
+
+    /**
+     * A forward iterator over the alternatives of a DependencyView.
+     */
+    class Q_DECL_EXPORT const_iterator
+    {
+    public:
+        const_iterator();
+
+        Alternative operator*() const;
+        const_iterator &operator++();
+        bool operator==(const const_iterator &other) const;
+        bool operator!=(const const_iterator &other) const;
+
+    private:
+        const_iterator(const pkgCache::DepIterator &dep, DependencyType type);
+
+        void skipFiltered();
+
+        pkgCache::DepIterator m_dep;
+        DependencyType m_type;
+
+        friend class DependencyView;
+    };
+
+    /**
+     * Constructs an empty view.
+     */
+    DependencyView();
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    /**
+     * Returns whether the view contains no dependencies.
+     */
+    bool isEmpty() const;
+
+    /**
+     * Returns the dependency type the view is limited to, or
+     * @c InvalidType if the view covers all dependency types.
+     */
+    DependencyType dependencyType() const;
+
+    /**
+     * Converts the view into a list of allocated DependencyItems, one for
+     * each "or" group.
+     */
+    QList<DependencyItem> toDependencyItems() const;
+
+private:
+    DependencyView(const pkgCache::VerIterator &ver, DependencyType type);
+
+    static DependencyInfo dependencyInfo(const Alternative &alternative);
+
+    pkgCache::VerIterator m_version;
+    DependencyType m_type;
+
+    friend class Package;
+};
+
+}
+
+#endif
@@ -104,6 +104,24 @@ DownloadProgress &DownloadProgress::operator=(const DownloadProgress &rhs)
     return *this;
 }
 
+bool DownloadProgress::operator==(const DownloadProgress &other) const
+{
+    if (d == other.d)
+        return true;
+
+    return d->uri == other.d->uri &&
+           d->status == other.d->status &&
+           d->shortDesc == other.d->shortDesc &&
+           d->fileSize == other.d->fileSize &&
+           d->fetchedSize == other.d->fetchedSize &&
+           d->statusMessage == other.d->statusMessage;
+}
+
+bool DownloadProgress::operator!=(const DownloadProgress &other) const
+{
+    return !(*this == other);
+}
+
 QString DownloadProgress::uri() const
 {
     return d->uri;
@@ -173,6 +191,8 @@ void DownloadProgress::registerMetaTypes()
 {
     qRegisterMetaType<QApt::DownloadProgress>("QApt::DownloadProgress");
     qDBusRegisterMetaType<QApt::DownloadProgress>();
+    qRegisterMetaType<QApt::DownloadProgressList>("QApt::DownloadProgressList");
+    qDBusRegisterMetaType<QApt::DownloadProgressList>();
 }
 
 const QDBusArgument &operator>>(const QDBusArgument &argument,
@@ -21,6 +21,7 @@
 #ifndef DOWNLOADPROGRESS_H
 #define DOWNLOADPROGRESS_H
 
+#include <QList>
 #include <QSharedDataPointer>
 #include <QString>
 
@@ -67,6 +68,15 @@ public:
      */
     DownloadProgress &operator=(const DownloadProgress &rhs);
 
+    /**
+     * Returns whether this download progress describes the same state of the
+     * same URI as @a other.
+     *
+     * @since 6.0
+     */
+    bool operator==(const DownloadProgress &other) const;
+    bool operator!=(const DownloadProgress &other) const;
+
     /**
      * Returns the uniform resource identifier for the file being
      * downloaded. (Its remote path.)
@@ -132,6 +142,15 @@ private:
 
 }
 
+namespace QApt {
+    /**
+     * Defines the DownloadProgressList type, which is a QList of DownloadProgress
+     *
+     * @since 6.0
+     */
+    typedef QList<DownloadProgress> DownloadProgressList;
+}
+
 Q_DECLARE_TYPEINFO(QApt::DownloadProgress, Q_MOVABLE_TYPE);
 Q_DECLARE_METATYPE(QApt::DownloadProgress)
 
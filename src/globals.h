@@ -196,7 +196,10 @@ namespace QApt
         /// The transaction will download package archives
         DownloadArchivesRole,
         /// The transaction will install a .deb file
-        InstallFileRole
+        InstallFileRole,
+        /// The transaction will bring the on-disk package cache up to date
+        /// (@since 6.0)
+        RebuildCacheRole
     };
 
     /**
@@ -248,7 +251,33 @@ namespace QApt
         /// QString, the string describing the current error in detail
         ErrorDetailsProperty,
         /// int, the frontend capabilities for the transaction
-        FrontendCapsProperty
+        FrontendCapsProperty,
+        /// int, the process id of the process holding a lock the transaction waits for
+        LockHolderPidProperty,
+        /// QString, the command line of the process holding a lock the transaction waits for
+        LockHolderCommandProperty,
+        /// quint64, the number of bytes of terminal output written so far
+        TerminalOutputSizeProperty,
+        /// int, the minimum interval in msec between batched progress updates
+        UpdateIntervalProperty,
+        /// DownloadProgressList, the download items that changed since the last update
+        DownloadItemsProperty,
+        /// int, the TransactionPriority of the transaction
+        PriorityProperty,
+        /// bool, whether packages are installed while others still download
+        StreamingInstallProperty,
+        /// bool, whether the changes may be made along with other transactions
+        CoalescableProperty,
+        /// QString, the Acquire::Queue-Mode used for downloads
+        QueueModeProperty,
+        /// int, the most downloads from different hosts at once
+        MaxParallelDownloadsProperty,
+        /// int, the number of HTTP requests pipelined on a connection
+        PipelineDepthProperty,
+        /// int, how often failed downloads are retried
+        DownloadRetriesProperty,
+        /// quint64, the highest download rate in bytes per second, 0 if unlimited
+        DownloadLimitProperty
     };
 
     /**
@@ -333,6 +362,28 @@ namespace QApt
         ConfigPromptCap,
         UntrustedPromptCap
     };
+
+    /**
+     * @brief Enumerates the priority classes of transactions
+     *
+     * Queued transactions of a higher priority run before those of a lower
+     * priority. Background transactions that are downloading are interrupted
+     * when they keep higher priority transactions from running, and are
+     * queued again. While a transaction of a higher priority downloads,
+     * background transactions download at a trickle.
+     *
+     * @since 6.0
+     */
+    enum TransactionPriority {
+        /// Work nobody is waiting for, such as periodic cache updates
+        BackgroundPriority = 0,
+        /// The default priority
+        NormalPriority,
+        /// Security updates
+        SecurityPriority,
+        /// Work the user is actively waiting for
+        InteractivePriority
+    };
 }
 
 Q_DECLARE_TYPEINFO(QList<int>, Q_MOVABLE_TYPE);
@@ -55,6 +55,7 @@
 #include "backend.h"
 #include "cache.h"
 #include "config.h" // krazy:exclude=includes
+#include "depcacheoverlay.h"
 #include "markingerrorinfo.h"
 
 namespace QApt {
@@ -682,8 +683,6 @@ qint64 Package::downloadSize() const
 
 int Package::state() const
 {
-    int packageState = 0;
-
     const pkgCache::VerIterator &ver = d->packageIter.CurrentVer();
     pkgDepCache::StateCache &stateCache = (*d->backend->cache()->depCache())[d->packageIter];
 
@@ -691,34 +690,12 @@ int Package::state() const
         d->initStaticState(ver, stateCache);
     }
 
-    if (stateCache.Install()) {
-        packageState |= ToInstall;
-    }
+    int packageState = DepCacheOverlay::packageState(stateCache);
 
     if (stateCache.Flags & pkgCache::Flag::Auto) {
         packageState |= QApt::Package::IsAuto;
     }
 
-    if (stateCache.iFlags & pkgDepCache::ReInstall) {
-        packageState |= ToReInstall;
-    } else if (stateCache.NewInstall()) { // Order matters here.
-        packageState |= NewInstall;
-    } else if (stateCache.Upgrade()) {
-        packageState |= ToUpgrade;
-    } else if (stateCache.Downgrade()) {
-        packageState |= ToDowngrade;
-    } else if (stateCache.Delete()) {
-        packageState |= ToRemove;
-        if (stateCache.iFlags & pkgDepCache::Purge) {
-            packageState |= ToPurge;
-        }
-    } else if (stateCache.Keep()) {
-        packageState |= ToKeep;
-        if (stateCache.Held()) {
-            packageState |= QApt::Package::Held;
-        }
-    }
-
    return packageState | d->state;
 }
 
@@ -735,17 +712,11 @@ int Package::staticState() const
 
 int Package::compareVersion(const QString &v1, const QString &v2)
 {
-    // Make deep copies of toStdString(), since otherwise they would
-    // go out of scope when we call c_str()
-    std::string s1 = v1.toStdString();
-    std::string s2 = v2.toStdString();
-
-    const char *a = s1.c_str();
-    const char *b = s2.c_str();
-    int lenA = strlen(a);
-    int lenB = strlen(b);
+    const QByteArray a = v1.toUtf8();
+    const QByteArray b = v2.toUtf8();
 
-    return _system->VS->DoCmpVersion(a, a+lenA, b, b+lenB);
+    return _system->VS->DoCmpVersion(a.constData(), a.constData() + a.size(),
+                                     b.constData(), b.constData() + b.size());
 }
 
 bool Package::isInstalled() const
@@ -786,6 +757,53 @@ bool Package::isInUpdatePhase() const
         return d->setInUpdatePhase(true);
     }
 
+    const QString machineId = updatePhaseMachineId();
+    if (machineId.isEmpty()) {
+        // Without machineId we cannot differentiate one machine from another, so
+        // we have no way to build a unique hash.
+        return true; // Don't change cache as we might have more luck next time.
+    }
+
+    QString seedString = QStringLiteral("%1-%2-%3").arg(sourcePackage(),
+                                                        availableVersion(),
+                                                        machineId);
+
+    // rand is the percentage at which the machine starts to be in the phase.
+    // Once rand is less than the phasing percentage e.g. 40rand vs. 50phase
+    // the machine is supposed to start phasing.
+    return d->setInUpdatePhase(updatePhaseThreshold(seedString) <= phasedUpdatePercent);
+}
+
+bool Package::cachedUpdatePhase(bool *inUpdatePhase) const
+{
+    if (!d->inUpdatePhaseCalculated) {
+        return false;
+    }
+
+    *inUpdatePhase = d->isInUpdatePhase;
+    return true;
+}
+
+void Package::setCachedUpdatePhase(bool inUpdatePhase) const
+{
+    d->setInUpdatePhase(inUpdatePhase);
+}
+
+QString Package::updatePhaseMachineId()
+{
+    static QString machineId;
+    if (machineId.isNull()) {
+        QFile file(QStringLiteral("/var/lib/dbus/machine-id"));
+        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            machineId = file.readLine().trimmed();
+        }
+    }
+
+    return machineId;
+}
+
+int Package::updatePhaseThreshold(const QString &seedString)
+{
     // This is a more or less an exact reimplementation of the update phasing
     // algorithm Ubuntu uses.
     // Deciding whether a machine is in the phasing pool or not happens in
@@ -800,23 +818,6 @@ bool Package::isInUpdatePhase() const
     // stable randomness based on the stable seed. Combined with the discrete
     // quasi-randomiziation we get about even distribution of machines across
     // phases.
-    static QString machineId;
-    if (machineId.isNull()) {
-        QFile file(QStringLiteral("/var/lib/dbus/machine-id"));
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            machineId = file.readLine().trimmed();
-        }
-    }
-
-    if (machineId.isEmpty()) {
-        // Without machineId we cannot differentiate one machine from another, so
-        // we have no way to build a unique hash.
-        return true; // Don't change cache as we might have more luck next time.
-    }
-
-    QString seedString = QStringLiteral("%1-%2-%3").arg(sourcePackage(),
-                                                        availableVersion(),
-                                                        machineId);
     QByteArray seed = QCryptographicHash::hash(seedString.toLatin1(), QCryptographicHash::Md5);
     // MD5 would be 128bits, that's two quint64 stdlib random default_engine
     // uses a uint32 seed though, so we'd loose precision anyway, so screw
@@ -832,12 +833,7 @@ bool Package::isInUpdatePhase() const
 
     std::default_random_engine generator(a);
     std::uniform_int_distribution<int> distribution(0, 100);
-    int rand = distribution(generator);
-
-    // rand is the percentage at which the machine starts to be in the phase.
-    // Once rand is less than the phasing percentage e.g. 40rand vs. 50phase
-    // the machine is supposed to start phasing.
-    return d->setInUpdatePhase(rand <= phasedUpdatePercent);
+    return distribution(generator);
 }
 
 bool Package::isMultiArchDuplicate() const
@@ -881,49 +877,56 @@ bool Package::isForeignArch() const
     return d->isForeignArch;
 }
 
+DependencyView Package::dependencyView(DependencyType type) const
+{
+    pkgDepCache *depCache = d->backend->cache()->depCache();
+
+    return DependencyView(depCache->GetCandidateVersion(d->packageIter), type);
+}
+
 QList<DependencyItem> Package::depends() const
 {
-    return DependencyInfo::parseDepends(controlField("Depends"), Depends);
+    return dependencyView(Depends).toDependencyItems();
 }
 
 QList<DependencyItem> Package::preDepends() const
 {
-    return DependencyInfo::parseDepends(controlField("Pre-Depends"), PreDepends);
+    return dependencyView(PreDepends).toDependencyItems();
 }
 
 QList<DependencyItem> Package::suggests() const
 {
-    return DependencyInfo::parseDepends(controlField("Suggests"), Suggests);
+    return dependencyView(Suggests).toDependencyItems();
 }
 
 QList<DependencyItem> Package::recommends() const
 {
-    return DependencyInfo::parseDepends(controlField("Recommends"), Recommends);
+    return dependencyView(Recommends).toDependencyItems();
 }
 
 QList<DependencyItem> Package::conflicts() const
 {
-    return DependencyInfo::parseDepends(controlField("Conflicts"), Conflicts);
+    return dependencyView(Conflicts).toDependencyItems();
 }
 
 QList<DependencyItem> Package::replaces() const
 {
-    return DependencyInfo::parseDepends(controlField("Replaces"), Replaces);
+    return dependencyView(Replaces).toDependencyItems();
 }
 
 QList<DependencyItem> Package::obsoletes() const
 {
-    return DependencyInfo::parseDepends(controlField("Obsoletes"), Obsoletes);
+    return dependencyView(Obsoletes).toDependencyItems();
 }
 
 QList<DependencyItem> Package::breaks() const
 {
-    return DependencyInfo::parseDepends(controlField("Breaks"), Breaks);
+    return dependencyView(Breaks).toDependencyItems();
 }
 
 QList<DependencyItem> Package::enhances() const
 {
-    return DependencyInfo::parseDepends(controlField("Enhance"), Enhances);
+    return dependencyView(Enhances).toDependencyItems();
 }
 
 QStringList Package::dependencyList(bool useCandidateVersion) const
@@ -1239,22 +1242,18 @@ bool Package::wouldBreak() const
 void Package::setAuto(bool flag)
 {
     d->backend->cache()->depCache()->MarkAuto(d->packageIter, flag);
+    d->backend->markingChanged();
 }
 
 
 void Package::setKeep()
 {
-    d->backend->cache()->depCache()->MarkKeep(d->packageIter, false);
-    if (state() & ToReInstall) {
-        d->backend->cache()->depCache()->SetReInstall(d->packageIter, false);
-    }
-    if (d->backend->cache()->depCache()->BrokenCount() > 0) {
-        pkgProblemResolver Fix(d->backend->cache()->depCache());
-        Fix.ResolveByKeep();
-    }
+    DepCacheOverlay::mark(*d->backend->cache()->depCache(), d->packageIter, ToKeep);
 
     d->state |= IsManuallyHeld;
 
+    d->backend->markingChanged();
+
     if (!d->backend->areEventsCompressed()) {
         d->backend->emitPackageChanged();
     }
@@ -1262,17 +1261,10 @@ void Package::setKeep()
 
 void Package::setInstall()
 {
-    d->backend->cache()->depCache()->MarkInstall(d->packageIter, true);
+    DepCacheOverlay::mark(*d->backend->cache()->depCache(), d->packageIter, ToInstall);
     d->state &= ~IsManuallyHeld;
 
-    // FIXME: can't we get rid of it here?
-    // if there is something wrong, try to fix it
-    if (!(state() & ToInstall) || d->backend->cache()->depCache()->BrokenCount() > 0) {
-        pkgProblemResolver Fix(d->backend->cache()->depCache());
-        Fix.Clear(d->packageIter);
-        Fix.Protect(d->packageIter);
-        Fix.Resolve(true);
-    }
+    d->backend->markingChanged();
 
     if (!d->backend->areEventsCompressed()) {
         d->backend->emitPackageChanged();
@@ -1281,9 +1273,11 @@ void Package::setInstall()
 
 void Package::setReInstall()
 {
-    d->backend->cache()->depCache()->SetReInstall(d->packageIter, true);
+    DepCacheOverlay::mark(*d->backend->cache()->depCache(), d->packageIter, ToReInstall);
     d->state &= ~IsManuallyHeld;
 
+    d->backend->markingChanged();
+
     if (!d->backend->areEventsCompressed()) {
         d->backend->emitPackageChanged();
     }
@@ -1292,19 +1286,12 @@ void Package::setReInstall()
 // TODO: merge into one function with bool_purge param
 void Package::setRemove()
 {
-    pkgProblemResolver Fix(d->backend->cache()->depCache());
-
-    Fix.Clear(d->packageIter);
-    Fix.Protect(d->packageIter);
-    Fix.Remove(d->packageIter);
-
-    d->backend->cache()->depCache()->SetReInstall(d->packageIter, false);
-    d->backend->cache()->depCache()->MarkDelete(d->packageIter, false);
-
-    Fix.Resolve(true);
+    DepCacheOverlay::mark(*d->backend->cache()->depCache(), d->packageIter, ToRemove);
 
     d->state &= ~IsManuallyHeld;
 
+    d->backend->markingChanged();
+
     if (!d->backend->areEventsCompressed()) {
         d->backend->emitPackageChanged();
     }
@@ -1312,19 +1299,12 @@ void Package::setRemove()
 
 void Package::setPurge()
 {
-    pkgProblemResolver Fix(d->backend->cache()->depCache());
-
-    Fix.Clear(d->packageIter);
-    Fix.Protect(d->packageIter);
-    Fix.Remove(d->packageIter);
-
-    d->backend->cache()->depCache()->SetReInstall(d->packageIter, false);
-    d->backend->cache()->depCache()->MarkDelete(d->packageIter, true);
-
-    Fix.Resolve(true);
+    DepCacheOverlay::mark(*d->backend->cache()->depCache(), d->packageIter, ToPurge);
 
     d->state &= ~IsManuallyHeld;
 
+    d->backend->markingChanged();
+
     if (!d->backend->areEventsCompressed()) {
         d->backend->emitPackageChanged();
     }
@@ -1352,6 +1332,8 @@ bool Package::setVersion(const QString &version)
         break;
     }
 
+    d->backend->markingChanged();
+
     if (isDefault)
         d->state &= ~OverrideVersion;
     else
@@ -30,6 +30,7 @@
 #include <apt-pkg/pkgcache.h>
 
 #include "dependencyinfo.h"
+#include "dependencyview.h"
 #include "globals.h"
 
 namespace QApt {
@@ -353,6 +354,8 @@ public:
     * Compares v1 with v2 and returns an integer less than, equal to, or
     * greater than zero if s1 is less than, equal to, or greater than s2.
     *
+    * @see VersionKey for comparing the same versions repeatedly
+    *
     * @since 1.2
     */
     static int compareVersion(const QString &v1, const QString &v2);
@@ -382,6 +385,8 @@ public:
      * @warning this function uses statics and is not in the least way threadsafe
      *          nor reentrant.
      *
+     * @see Backend::packagesInUpdatePhase() to check many packages at once
+     *
      * @since 3.1
      */
     bool isInUpdatePhase() const;
@@ -445,6 +450,17 @@ public:
     */
     bool isForeignArch() const;
 
+    /**
+     * Returns a non-allocating view of the dependencies of the candidate
+     * version, read directly from the APT cache.
+     *
+     * @param type The dependency type to limit the view to, or
+     *             @c InvalidType for all dependencies
+     *
+     * @since 6.0
+     */
+    DependencyView dependencyView(DependencyType type = InvalidType) const;
+
     /// Returns a list of DependencyItems that this package depends on.
     QList<DependencyItem> depends() const;
 
@@ -675,7 +691,32 @@ private:
       */
      int staticState() const;
 
+     /**
+      * Returns the D-Bus machine id used to seed the update phasing
+      * calculation, or an empty string if it cannot be determined.
+      */
+     static QString updatePhaseMachineId();
+
+     /**
+      * Returns the repeatable random number between 0 and 100 at which a
+      * machine enters the update phase. The seed string is made up of
+      * "sourcename-sourceversion-machineid". Reentrant.
+      */
+     static int updatePhaseThreshold(const QString &seedString);
+
+     /**
+      * Returns whether isInUpdatePhase() has been calculated, and if so,
+      * stores the result in @p inUpdatePhase.
+      */
+     bool cachedUpdatePhase(bool *inUpdatePhase) const;
+
+     /**
+      * Stores the result of isInUpdatePhase(), calculated elsewhere.
+      */
+     void setCachedUpdatePhase(bool inUpdatePhase) const;
+
      friend class Backend;
+     friend class BackendPrivate;
 };
 
 /**
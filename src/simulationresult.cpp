@@ -0,0 +1,118 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "simulationresult.h"
+
+// Qt includes
+#include <QSharedData>
+
+namespace QApt {
+
+class SimulationResultPrivate : public QSharedData
+{
+public:
+    SimulationResultPrivate()
+        : QSharedData()
+        , valid(false)
+        , downloadSize(0)
+        , installSize(0)
+        , broken(false)
+    {
+    }
+
+    SimulationResultPrivate(const StateChanges &sChanges, qint64 dSize,
+                            qint64 iSize, bool isBroken)
+        : QSharedData()
+        , valid(true)
+        , changes(sChanges)
+        , downloadSize(dSize)
+        , installSize(iSize)
+        , broken(isBroken)
+    {
+    }
+
+    bool valid;
+    StateChanges changes;
+    qint64 downloadSize;
+    qint64 installSize;
+    bool broken;
+};
+
+SimulationResult::SimulationResult()
+    : d(new SimulationResultPrivate)
+{
+}
+
+SimulationResult::SimulationResult(const StateChanges &changes, qint64 downloadSize,
+                                   qint64 installSize, bool broken)
+    : d(new SimulationResultPrivate(changes, downloadSize, installSize, broken))
+{
+}
+
+SimulationResult::SimulationResult(const SimulationResult &other)
+    : d(other.d)
+{
+}
+
+SimulationResult::~SimulationResult()
+{
+}
+
+SimulationResult &SimulationResult::operator=(const SimulationResult &rhs)
+{
+    // Protect against self-assignment
+    if (this == &rhs) {
+        return *this;
+    }
+    d = rhs.d;
+    return *this;
+}
+
+bool SimulationResult::isValid() const
+{
+    return d->valid;
+}
+
+StateChanges SimulationResult::changes() const
+{
+    return d->changes;
+}
+
+PackageList SimulationResult::newPackages() const
+{
+    return d->changes.value(Package::NewInstall);
+}
+
+qint64 SimulationResult::downloadSize() const
+{
+    return d->downloadSize;
+}
+
+qint64 SimulationResult::installSize() const
+{
+    return d->installSize;
+}
+
+bool SimulationResult::isBroken() const
+{
+    return d->broken;
+}
+
+}
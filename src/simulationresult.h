@@ -0,0 +1,115 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef QAPT_SIMULATIONRESULT_H
+#define QAPT_SIMULATIONRESULT_H
+
+#include <QSharedDataPointer>
+
+#include "package.h"
+
+namespace QApt {
+
+class SimulationResultPrivate;
+
+/**
+ * The SimulationResult class describes what marking a set of packages would
+ * do to the current marking state, as calculated by Backend::simulate().
+ *
+ * All sizes are relative to the marking state at the time the simulation
+ * was started.
+ *
+ * @since 6.0
+ */
+class Q_DECL_EXPORT SimulationResult
+{
+public:
+    /**
+     * Constructs an invalid simulation result.
+     */
+    SimulationResult();
+
+    /**
+     * Constructs a new simulation result from the given data.
+     */
+    SimulationResult(const StateChanges &changes, qint64 downloadSize,
+                     qint64 installSize, bool broken);
+
+    /**
+     * Constructs a copy of the @a other simulation result.
+     */
+    SimulationResult(const SimulationResult &other);
+
+    /**
+     * Destroys the simulation result.
+     */
+    ~SimulationResult();
+
+    /**
+     * Assigns @a other to this simulation result and returns a reference
+     * to this simulation result.
+     */
+    SimulationResult &operator=(const SimulationResult &rhs);
+
+    /**
+     * Returns whether the simulation could be carried out. Simulations fail
+     * when the cache is reloaded before they get to run.
+     */
+    bool isValid() const;
+
+    /**
+     * Returns the packages whose state would change, grouped by the new
+     * state, in the same format as Backend::stateChanges().
+     */
+    StateChanges changes() const;
+
+    /**
+     * Returns the packages that would be newly installed.
+     */
+    PackageList newPackages() const;
+
+    /**
+     * Returns the number of bytes that would additionally have to be
+     * downloaded. Packages that are already in the archive cache are
+     * counted as well.
+     */
+    qint64 downloadSize() const;
+
+    /**
+     * Returns the number of bytes of disk space that would additionally be
+     * used. If more space would be freed than used, this is negative.
+     */
+    qint64 installSize() const;
+
+    /**
+     * Returns whether the marking would leave broken packages behind.
+     */
+    bool isBroken() const;
+
+private:
+    QSharedDataPointer<SimulationResultPrivate> d;
+};
+
+}
+
+Q_DECLARE_TYPEINFO(QApt::SimulationResult, Q_MOVABLE_TYPE);
+Q_DECLARE_METATYPE(QApt::SimulationResult)
+
+#endif
@@ -22,6 +22,9 @@
 
 // Qt includes
 #include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusArgument>
+#include <QHash>
 #include <QDBusVariant>
 
 #include <QDebug>
@@ -47,6 +50,16 @@ class TransactionPrivate
             , progress(0)
             , downloadSpeed(0)
             , downloadETA(0)
+            , lockHolderPid(0)
+            , terminalOutputSize(0)
+            , updateInterval(100)
+            , priority(QApt::NormalPriority)
+            , streamingInstall(false)
+            , isCoalescable(false)
+            , maxParallelDownloads(-1)
+            , pipelineDepth(-1)
+            , downloadRetries(-1)
+            , downloadLimit(0)
         {
             dbus = new TransactionInterface(QLatin1String(s_workerReverseDomainName),
                                             tid, QDBusConnection::systemBus(),
@@ -85,6 +98,21 @@ class TransactionPrivate
         QString filePath;
         QString errorDetails;
         QApt::FrontendCaps frontendCaps;
+        int lockHolderPid;
+        QString lockHolderCommand;
+        quint64 terminalOutputSize;
+        int updateInterval;
+        QString peerName;
+        DownloadProgressList downloadItems;
+        QHash<QString, int> downloadItemIndex;
+        TransactionPriority priority;
+        bool streamingInstall;
+        bool isCoalescable;
+        QString queueMode;
+        int maxParallelDownloads;
+        int pipelineDepth;
+        int downloadRetries;
+        quint64 downloadLimit;
 };
 
 Transaction::Transaction(const QString &tid)
@@ -93,27 +121,100 @@ Transaction::Transaction(const QString &tid)
 {
     // Fetch property data from D-Bus
     sync();
+    init();
+}
+
+Transaction::Transaction(const QVariantMap &properties)
+    : QObject()
+    , d(new TransactionPrivate(properties.value(QLatin1String("transactionId")).toString()))
+{
+    applyProperties(properties);
+    init();
+
+    // The transaction is already queued, so it may have changed between
+    // the worker taking the snapshot and us subscribing to its signals
+    QDBusPendingCall call = d->dbus->connection().asyncCall(propertiesCall());
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onResyncFinished(QDBusPendingCallWatcher*)));
+}
 
+void Transaction::init()
+{
     d->watcher = new QDBusServiceWatcher(this);
     d->watcher->setConnection(QDBusConnection::systemBus());
     d->watcher->setWatchMode(QDBusServiceWatcher::WatchForOwnerChange);
     d->watcher->addWatchedService(QLatin1String(s_workerReverseDomainName));
 
+    connectInterface();
+    connect(d->watcher, SIGNAL(serviceOwnerChanged(QString,QString,QString)),
+            this, SLOT(serviceOwnerChanged(QString,QString,QString)));
+}
+
+Transaction::~Transaction()
+{
+    const QString peerName = d->peerName;
+    delete d;
+
+    if (!peerName.isEmpty())
+        QDBusConnection::disconnectFromPeer(peerName);
+}
+
+void Transaction::connectInterface()
+{
     connect(d->dbus, SIGNAL(propertyChanged(int,QDBusVariant)),
             this, SLOT(updateProperty(int,QDBusVariant)));
+    connect(d->dbus, SIGNAL(propertiesChanged(QVariantMap)),
+            this, SLOT(updateProperties(QVariantMap)));
     connect(d->dbus, SIGNAL(mediumRequired(QString,QString)),
             this, SIGNAL(mediumRequired(QString,QString)));
     connect(d->dbus, SIGNAL(promptUntrusted(QStringList)),
             this, SIGNAL(promptUntrusted(QStringList)));
     connect(d->dbus, SIGNAL(configFileConflict(QString,QString)),
             this, SIGNAL(configFileConflict(QString,QString)));
-    connect(d->watcher, SIGNAL(serviceOwnerChanged(QString,QString,QString)),
-            this, SLOT(serviceOwnerChanged(QString,QString,QString)));
 }
 
-Transaction::~Transaction()
+bool Transaction::usePeerConnection()
 {
-    delete d;
+    if (!d->peerName.isEmpty())
+        return true;
+
+    QDBusPendingReply<QString, QString> reply = d->dbus->requestPeerConnection();
+    reply.waitForFinished();
+
+    if (reply.isError())
+        return false;
+
+    const QString address = reply.argumentAt<0>();
+    const QString token = reply.argumentAt<1>();
+    const QString peerName = QLatin1String("qapt-peer-") + d->tid;
+
+    QDBusConnection peer = QDBusConnection::connectToPeer(address, peerName);
+    if (!peer.isConnected()) {
+        QDBusConnection::disconnectFromPeer(peerName);
+        return false;
+    }
+
+    // Redeem the token, moving the transaction to the peer connection
+    QDBusMessage attach = QDBusMessage::createMethodCall(QString(), QLatin1String("/"),
+                                                         QString(), QLatin1String("attach"));
+    attach << token;
+
+    QDBusReply<bool> attached = peer.call(attach);
+    if (!attached.isValid() || !attached.value()) {
+        QDBusConnection::disconnectFromPeer(peerName);
+        return false;
+    }
+
+    delete d->dbus;
+    d->dbus = new TransactionInterface(QString(), d->tid, peer, 0);
+    d->peerName = peerName;
+    connectInterface();
+
+    // Catch up on anything that happened during the switch
+    sync();
+
+    return true;
 }
 
 bool Transaction::operator==(const Transaction* rhs) const
@@ -470,6 +571,258 @@ void Transaction::updateFrontendCaps(FrontendCaps frontendCaps)
     d->frontendCaps = frontendCaps;
 }
 
+int Transaction::updateInterval() const
+{
+    return d->updateInterval;
+}
+
+void Transaction::setUpdateInterval(int interval)
+{
+    QDBusPendingCall call = d->dbus->setProperty(QApt::UpdateIntervalProperty,
+                                                 QDBusVariant(interval));
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+}
+
+void Transaction::updateUpdateInterval(int interval)
+{
+    d->updateInterval = interval;
+}
+
+TransactionPriority Transaction::priority() const
+{
+    return d->priority;
+}
+
+void Transaction::setPriority(TransactionPriority priority)
+{
+    QDBusPendingCall call = d->dbus->setProperty(QApt::PriorityProperty,
+                                                 QDBusVariant((int)priority));
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+}
+
+void Transaction::updatePriority(TransactionPriority priority)
+{
+    d->priority = priority;
+}
+
+bool Transaction::streamingInstall() const
+{
+    return d->streamingInstall;
+}
+
+void Transaction::setStreamingInstall(bool streaming)
+{
+    QDBusPendingCall call = d->dbus->setProperty(QApt::StreamingInstallProperty,
+                                                 QDBusVariant(streaming));
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+}
+
+void Transaction::updateStreamingInstall(bool streaming)
+{
+    d->streamingInstall = streaming;
+}
+
+bool Transaction::isCoalescable() const
+{
+    return d->isCoalescable;
+}
+
+void Transaction::setCoalescable(bool coalescable)
+{
+    QDBusPendingCall call = d->dbus->setProperty(QApt::CoalescableProperty,
+                                                 QDBusVariant(coalescable));
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+}
+
+void Transaction::updateCoalescable(bool coalescable)
+{
+    d->isCoalescable = coalescable;
+}
+
+QString Transaction::queueMode() const
+{
+    return d->queueMode;
+}
+
+void Transaction::setQueueMode(const QString &mode)
+{
+    QDBusPendingCall call = d->dbus->setProperty(QApt::QueueModeProperty,
+                                                 QDBusVariant(mode));
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+}
+
+void Transaction::updateQueueMode(const QString &mode)
+{
+    d->queueMode = mode;
+}
+
+int Transaction::maxParallelDownloads() const
+{
+    return d->maxParallelDownloads;
+}
+
+void Transaction::setMaxParallelDownloads(int count)
+{
+    QDBusPendingCall call = d->dbus->setProperty(QApt::MaxParallelDownloadsProperty,
+                                                 QDBusVariant(count));
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+}
+
+void Transaction::updateMaxParallelDownloads(int count)
+{
+    d->maxParallelDownloads = count;
+}
+
+int Transaction::pipelineDepth() const
+{
+    return d->pipelineDepth;
+}
+
+void Transaction::setPipelineDepth(int depth)
+{
+    QDBusPendingCall call = d->dbus->setProperty(QApt::PipelineDepthProperty,
+                                                 QDBusVariant(depth));
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+}
+
+void Transaction::updatePipelineDepth(int depth)
+{
+    d->pipelineDepth = depth;
+}
+
+int Transaction::downloadRetries() const
+{
+    return d->downloadRetries;
+}
+
+void Transaction::setDownloadRetries(int retries)
+{
+    QDBusPendingCall call = d->dbus->setProperty(QApt::DownloadRetriesProperty,
+                                                 QDBusVariant(retries));
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+}
+
+void Transaction::updateDownloadRetries(int retries)
+{
+    d->downloadRetries = retries;
+}
+
+quint64 Transaction::downloadLimit() const
+{
+    return d->downloadLimit;
+}
+
+void Transaction::setDownloadLimit(quint64 limit)
+{
+    QDBusPendingCall call = d->dbus->setProperty(QApt::DownloadLimitProperty,
+                                                 QDBusVariant(limit));
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onCallFinished(QDBusPendingCallWatcher*)));
+}
+
+void Transaction::updateDownloadLimit(quint64 limit)
+{
+    d->downloadLimit = limit;
+}
+
+DownloadProgressList Transaction::downloadItems() const
+{
+    return d->downloadItems;
+}
+
+void Transaction::updateDownloadItems(const DownloadProgressList &items)
+{
+    d->downloadItems.clear();
+    d->downloadItemIndex.clear();
+    mergeDownloadItems(items);
+}
+
+void Transaction::mergeDownloadItems(const DownloadProgressList &changedItems)
+{
+    for (const DownloadProgress &item : changedItems) {
+        auto index = d->downloadItemIndex.constFind(item.uri());
+        if (index != d->downloadItemIndex.constEnd()) {
+            d->downloadItems[*index] = item;
+        } else {
+            d->downloadItemIndex.insert(item.uri(), d->downloadItems.size());
+            d->downloadItems.append(item);
+        }
+    }
+}
+
+int Transaction::lockHolderPid() const
+{
+    return d->lockHolderPid;
+}
+
+void Transaction::updateLockHolderPid(int pid)
+{
+    d->lockHolderPid = pid;
+}
+
+QString Transaction::lockHolderCommand() const
+{
+    return d->lockHolderCommand;
+}
+
+void Transaction::updateLockHolderCommand(const QString &command)
+{
+    d->lockHolderCommand = command;
+}
+
+quint64 Transaction::terminalOutputSize() const
+{
+    return d->terminalOutputSize;
+}
+
+void Transaction::updateTerminalOutputSize(quint64 size)
+{
+    d->terminalOutputSize = size;
+}
+
+QByteArray Transaction::terminalOutput(quint64 offset, quint64 *start) const
+{
+    QDBusPendingReply<QByteArray, qulonglong> reply = d->dbus->terminalOutput(offset);
+    reply.waitForFinished();
+
+    if (reply.isError()) {
+        if (start)
+            *start = offset;
+        return QByteArray();
+    }
+
+    if (start)
+        *start = reply.argumentAt<1>();
+
+    return reply.argumentAt<0>();
+}
+
 void Transaction::setProxy(const QString &proxy)
 {
     QDBusPendingCall call = d->dbus->setProperty(QApt::ProxyProperty,
@@ -581,7 +934,7 @@ void Transaction::serviceOwnerChanged(QString name, QString oldOwner, QString ne
     }
 }
 
-void Transaction::sync()
+QDBusMessage Transaction::propertiesCall() const
 {
     QString arg = QString("%1.%2").arg(QLatin1String(s_workerReverseDomainName),
                                        QLatin1String("transaction"));
@@ -589,12 +942,41 @@ void Transaction::sync()
                                                        "org.freedesktop.DBus.Properties", "GetAll");
     call.setArguments(QList<QVariant>() << arg);
 
-    QDBusReply<QVariantMap> reply = QDBusConnection::systemBus().call(call);
-    QVariantMap propertyMap = reply.value();
+    return call;
+}
 
-    if (propertyMap.isEmpty())
+void Transaction::sync()
+{
+    QDBusReply<QVariantMap> reply = d->dbus->connection().call(propertiesCall());
+
+    applyProperties(reply.value());
+}
+
+void Transaction::onResyncFinished(QDBusPendingCallWatcher *watcher)
+{
+    QDBusPendingReply<QVariantMap> reply = *watcher;
+    watcher->deleteLater();
+
+    if (reply.isError())
         return;
 
+    TransactionStatus oldStatus = d->status;
+    ErrorCode oldError = d->error;
+    ExitStatus oldExitStatus = d->exitStatus;
+
+    applyProperties(reply.value());
+
+    // Replay the changes whose signals were emitted before we listened
+    if (d->status != oldStatus)
+        emit statusChanged(d->status);
+    if (d->error != oldError)
+        emit errorOccurred(d->error);
+    if (d->exitStatus != oldExitStatus && d->exitStatus != QApt::ExitUnfinished)
+        emit finished(d->exitStatus);
+}
+
+void Transaction::applyProperties(const QVariantMap &propertyMap)
+{
     for (auto iter = propertyMap.constBegin(); iter != propertyMap.constEnd(); ++iter) {
         if (!setProperty(iter.key().toLatin1(), iter.value())) {
             // Qt won't support arbitrary enums over dbus until "maybe Qt 6 or 7"
@@ -608,13 +990,16 @@ void Transaction::sync()
             else if (iter.key() == QLatin1String("exitStatus"))
                 updateExitStatus((ExitStatus)iter.value().toInt());
             else if (iter.key() == QLatin1String("packages"))
-                // iter.value() for the QVariantMap is QDBusArgument, so we have to
-                // set this manually
-                setProperty(iter.key().toLatin1(), d->dbus->property(iter.key().toLatin1()));
+                // iter.value() for the QVariantMap is QDBusArgument
+                updatePackages(qdbus_cast<QVariantMap>(iter.value()));
             else if (iter.key() == QLatin1String("downloadProgress"))
-                updateDownloadProgress(iter.value().value<QApt::DownloadProgress>());
+                updateDownloadProgress(qdbus_cast<QApt::DownloadProgress>(iter.value()));
             else if (iter.key() == QLatin1String("frontendCaps"))
                 updateFrontendCaps((FrontendCaps)iter.value().toInt());
+            else if (iter.key() == QLatin1String("priority"))
+                updatePriority((TransactionPriority)iter.value().toInt());
+            else if (iter.key() == QLatin1String("downloadItems"))
+                updateDownloadItems(qdbus_cast<QApt::DownloadProgressList>(iter.value()));
             else
                 qDebug() << "failed to set:" << iter.key();
         }
@@ -706,11 +1091,65 @@ void Transaction::updateProperty(int type, const QDBusVariant &variant)
     case FrontendCapsProperty:
         updateFrontendCaps((FrontendCaps)variant.variant().toInt());
         break;
+    case LockHolderPidProperty:
+        updateLockHolderPid(variant.variant().toInt());
+        break;
+    case LockHolderCommandProperty:
+        // The worker always sends the command after the pid
+        updateLockHolderCommand(variant.variant().toString());
+        emit lockHolderChanged(lockHolderPid(), lockHolderCommand());
+        break;
+    case TerminalOutputSizeProperty:
+        updateTerminalOutputSize(variant.variant().toULongLong());
+        emit terminalOutputChanged(terminalOutputSize());
+        break;
+    case UpdateIntervalProperty:
+        updateUpdateInterval(variant.variant().toInt());
+        break;
+    case PriorityProperty:
+        updatePriority((TransactionPriority)variant.variant().toInt());
+        break;
+    case StreamingInstallProperty:
+        updateStreamingInstall(variant.variant().toBool());
+        break;
+    case CoalescableProperty:
+        updateCoalescable(variant.variant().toBool());
+        break;
+    case QueueModeProperty:
+        updateQueueMode(variant.variant().toString());
+        break;
+    case MaxParallelDownloadsProperty:
+        updateMaxParallelDownloads(variant.variant().toInt());
+        break;
+    case PipelineDepthProperty:
+        updatePipelineDepth(variant.variant().toInt());
+        break;
+    case DownloadRetriesProperty:
+        updateDownloadRetries(variant.variant().toInt());
+        break;
+    case DownloadLimitProperty:
+        updateDownloadLimit(variant.variant().toULongLong());
+        break;
+    case DownloadItemsProperty: {
+        const DownloadProgressList changedItems =
+                qdbus_cast<QApt::DownloadProgressList>(variant.variant());
+
+        mergeDownloadItems(changedItems);
+        emit downloadItemsChanged(changedItems);
+        break;
+    }
     default:
         break;
     }
 }
 
+void Transaction::updateProperties(const QVariantMap &changes)
+{
+    // Batched changes, keyed by the TransactionProperty number
+    for (auto iter = changes.constBegin(); iter != changes.constEnd(); ++iter)
+        updateProperty(iter.key().toInt(), QDBusVariant(iter.value()));
+}
+
 void Transaction::emitFinished(int exitStatus)
 {
     emit finished((QApt::ExitStatus)exitStatus);
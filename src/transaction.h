@@ -26,6 +26,7 @@
 
 #include "downloadprogress.h"
 
+class QDBusMessage;
 class QDBusPendingCallWatcher;
 class QDBusVariant;
 
@@ -58,11 +59,13 @@ class Q_DECL_EXPORT Transaction : public QObject
 #ifdef __CURRENTLY_UNIT_TESTING__
     friend TransactionErrorHandlingTest;
 #endif
+    friend class Backend;
     
     Q_ENUMS(TransactionRole)
     Q_ENUMS(TransactionStatus)
     Q_ENUMS(ErrorCode)
     Q_ENUMS(ExitStatus)
+    Q_ENUMS(TransactionPriority)
 
     Q_PROPERTY(QString transactionId READ transactionId WRITE updateTransactionId)
     Q_PROPERTY(int userId READ userId WRITE updateUserId)
@@ -86,6 +89,19 @@ class Q_DECL_EXPORT Transaction : public QObject
     Q_PROPERTY(QString filePath READ filePath WRITE updateFilePath)
     Q_PROPERTY(QString errorDetails READ errorDetails WRITE updateErrorDetails)
     Q_PROPERTY(FrontendCaps frontendCaps READ frontendCaps WRITE updateFrontendCaps)
+    Q_PROPERTY(int lockHolderPid READ lockHolderPid WRITE updateLockHolderPid)
+    Q_PROPERTY(QString lockHolderCommand READ lockHolderCommand WRITE updateLockHolderCommand)
+    Q_PROPERTY(quint64 terminalOutputSize READ terminalOutputSize WRITE updateTerminalOutputSize)
+    Q_PROPERTY(int updateInterval READ updateInterval WRITE updateUpdateInterval)
+    Q_PROPERTY(QApt::DownloadProgressList downloadItems READ downloadItems WRITE updateDownloadItems)
+    Q_PROPERTY(TransactionPriority priority READ priority WRITE updatePriority)
+    Q_PROPERTY(bool streamingInstall READ streamingInstall WRITE updateStreamingInstall)
+    Q_PROPERTY(bool coalescable READ isCoalescable WRITE updateCoalescable)
+    Q_PROPERTY(QString queueMode READ queueMode WRITE updateQueueMode)
+    Q_PROPERTY(int maxParallelDownloads READ maxParallelDownloads WRITE updateMaxParallelDownloads)
+    Q_PROPERTY(int pipelineDepth READ pipelineDepth WRITE updatePipelineDepth)
+    Q_PROPERTY(int downloadRetries READ downloadRetries WRITE updateDownloadRetries)
+    Q_PROPERTY(quint64 downloadLimit READ downloadLimit WRITE updateDownloadLimit)
 
 public:
     /**
@@ -268,9 +284,159 @@ public:
      */
     QApt::FrontendCaps frontendCaps() const;
 
+    /**
+     * Returns the process id of the process holding a package system lock
+     * while the transaction has the WaitingLockStatus, or 0 if the holder
+     * is unknown.
+     *
+     * @see lockHolderChanged
+     * @since 6.0
+     */
+    int lockHolderPid() const;
+
+    /**
+     * Returns the command name, without arguments, of the process holding a
+     * package system lock while the transaction has the WaitingLockStatus.
+     *
+     * @see lockHolderChanged
+     * @since 6.0
+     */
+    QString lockHolderCommand() const;
+
+    /**
+     * Returns the number of bytes the package manager has written to its
+     * terminal during the transaction so far. This is also the offset to
+     * continue reading from with terminalOutput().
+     *
+     * @see terminalOutputChanged
+     * @since 6.0
+     */
+    quint64 terminalOutputSize() const;
+
+    /**
+     * Fetches terminal output of the package manager, e.g. of dpkg and
+     * maintainer scripts, starting at byte @p offset. Only a limited amount
+     * of output is returned per call, and the worker only keeps the most
+     * recent output around. If output at @p offset has already been
+     * dropped, the returned chunk starts at the oldest output still kept.
+     *
+     * This is a blocking call to the worker.
+     *
+     * @param offset The offset to start reading at
+     * @param start If not null, set to the offset the returned output
+     * actually starts at
+     *
+     * @return The raw terminal output, or an empty byte array if there is
+     * no new output
+     *
+     * @since 6.0
+     */
+    QByteArray terminalOutput(quint64 offset, quint64 *start = nullptr) const;
+
+    /**
+     * Returns the minimum interval in milliseconds between updates of the
+     * progress, status details, download progress, download speed and
+     * download ETA properties.
+     *
+     * @see setUpdateInterval
+     * @since 6.0
+     */
+    int updateInterval() const;
+
+    /**
+     * Returns the progress of every item downloaded by the transaction so
+     * far, in the order the downloads started. Unlike downloadProgress(),
+     * this covers all parallel downloads.
+     *
+     * @see downloadItemsChanged
+     * @since 6.0
+     */
+    QApt::DownloadProgressList downloadItems() const;
+
+    /**
+     * Returns the priority class of the transaction, which decides which
+     * queued transactions the worker runs first.
+     *
+     * @see setPriority
+     * @since 6.0
+     */
+    QApt::TransactionPriority priority() const;
+
+    /**
+     * Returns whether the transaction installs packages while it is still
+     * downloading others.
+     *
+     * @see setStreamingInstall
+     * @since 6.0
+     */
+    bool streamingInstall() const;
+
+    /**
+     * Returns whether the changes of the transaction may be made in one go
+     * with those of other transactions.
+     *
+     * @see setCoalescable
+     * @since 6.0
+     */
+    bool isCoalescable() const;
+
+    /**
+     * Returns the queue mode used for the downloads of the transaction, or
+     * an empty string if the APT configuration is used.
+     *
+     * @see setQueueMode
+     * @since 6.0
+     */
+    QString queueMode() const;
+
+    /**
+     * Returns the most downloads the transaction runs at once, or -1 if
+     * the APT configuration is used.
+     *
+     * @see setMaxParallelDownloads
+     * @since 6.0
+     */
+    int maxParallelDownloads() const;
+
+    /**
+     * Returns the number of HTTP requests the transaction pipelines on a
+     * connection, or -1 if the APT configuration is used.
+     *
+     * @see setPipelineDepth
+     * @since 6.0
+     */
+    int pipelineDepth() const;
+
+    /**
+     * Returns how often the transaction retries a failed download, or -1
+     * if the APT configuration is used.
+     *
+     * @see setDownloadRetries
+     * @since 6.0
+     */
+    int downloadRetries() const;
+
+    /**
+     * Returns the highest rate in bytes per second at which the transaction
+     * downloads, or 0 if the rate is unlimited.
+     *
+     * @see setDownloadLimit
+     * @since 6.0
+     */
+    quint64 downloadLimit() const;
+
 private:
     TransactionPrivate *const d;
 
+    /**
+     * Constructs a transaction that was started with a single call to the
+     * worker, from the @p properties the worker returned for it.
+     */
+    explicit Transaction(const QVariantMap &properties);
+
+    void init();
+    void applyProperties(const QVariantMap &properties);
+    QDBusMessage propertiesCall() const;
     void updateTransactionId(const QString &tid);
     void updateUserId(int id);
     void updateRole(QApt::TransactionRole role);
@@ -293,6 +459,21 @@ private:
     void updateFilePath(const QString &filePath);
     void updateErrorDetails(const QString &errorDetails);
     void updateFrontendCaps(QApt::FrontendCaps frontendCaps);
+    void updateLockHolderPid(int pid);
+    void updateLockHolderCommand(const QString &command);
+    void updateTerminalOutputSize(quint64 size);
+    void updateUpdateInterval(int interval);
+    void updateDownloadItems(const QApt::DownloadProgressList &items);
+    void updatePriority(QApt::TransactionPriority priority);
+    void updateStreamingInstall(bool streaming);
+    void updateCoalescable(bool coalescable);
+    void updateQueueMode(const QString &mode);
+    void updateMaxParallelDownloads(int count);
+    void updatePipelineDepth(int depth);
+    void updateDownloadRetries(int retries);
+    void updateDownloadLimit(quint64 limit);
+    void mergeDownloadItems(const QApt::DownloadProgressList &changedItems);
+    void connectInterface();
 
 Q_SIGNALS:
     /**
@@ -355,6 +536,41 @@ Q_SIGNALS:
      */
     void downloadProgressChanged(QApt::DownloadProgress progress);
 
+    /**
+     * This signal is emitted when the progress of one or more download
+     * items changes. Only the changed items are passed, the complete list
+     * is available from downloadItems().
+     *
+     * @param changedItems The items that changed since the last emission
+     *
+     * @since 6.0
+     */
+    void downloadItemsChanged(const QApt::DownloadProgressList &changedItems);
+
+    /**
+     * This signal is emitted when the process holding the package system
+     * lock the transaction is waiting for changes. Once the lock has been
+     * taken, it is emitted with a @a pid of 0 and an empty @a command.
+     *
+     * @param pid The process id of the lock holder
+     * @param command The command line of the lock holder
+     *
+     * @since 6.0
+     */
+    void lockHolderChanged(int pid, const QString &command);
+
+    /**
+     * This signal is emitted when there is new terminal output available.
+     * To keep bus traffic bounded it is emitted at most a few times per
+     * second, so several writes may have happened in between.
+     *
+     * @param size The new terminal output size
+     *
+     * @see terminalOutput
+     * @since 6.0
+     */
+    void terminalOutputChanged(quint64 size);
+
     /**
      * This signal is emitted when the transaction reaches the Finished state.
      *
@@ -481,6 +697,158 @@ public Q_SLOTS:
      */
     void setFrontendCaps(QApt::FrontendCaps frontendCaps);
 
+    /**
+     * Sets the minimum interval between updates of frequently changing
+     * properties, such as the progress. Changes within the interval are
+     * batched, and only the latest value of each property is sent. Status,
+     * error and exit status changes are always sent right away, after any
+     * batched changes. An interval of 0 sends every change on its own.
+     *
+     * The default is 100 milliseconds.
+     *
+     * @param interval The update interval in milliseconds
+     *
+     * @see updateInterval
+     * @since 6.0
+     */
+    void setUpdateInterval(int interval);
+
+    /**
+     * Sets the priority class of the transaction. Transactions of a higher
+     * priority run before queued transactions of a lower priority. A
+     * background transaction that is downloading is interrupted when it
+     * keeps one of a higher priority from running, and continues later.
+     *
+     * The default is QApt::NormalPriority. The priority can only be set
+     * before the transaction is run.
+     *
+     * @param priority The priority class of the transaction
+     *
+     * @see priority
+     * @since 6.0
+     */
+    void setPriority(QApt::TransactionPriority priority);
+
+    /**
+     * Sets whether a commit or upgrade installs packages while it is still
+     * downloading others. The changes are split into batches that can be
+     * installed on their own, and each batch is installed as soon as it is
+     * downloaded. Changes that are too closely tied to each other are
+     * installed in one go, as usual.
+     *
+     * If a download fails, the batches installed so far stay installed,
+     * and the transaction fails with QApt::FetchError. The transaction
+     * cannot be cancelled once the first batch is being installed.
+     *
+     * Streaming is off by default, and can only be set before the
+     * transaction is run.
+     *
+     * @param streaming Whether to install while downloading
+     *
+     * @see streamingInstall
+     * @since 6.0
+     */
+    void setStreamingInstall(bool streaming);
+
+    /**
+     * Sets whether the worker may make the changes of a commit transaction
+     * in one go with those of other queued commit transactions. The cache
+     * is then opened, the archives downloaded and dpkg run only once for
+     * all of them.
+     *
+     * Only transactions of the same user that have all set this, that share
+     * their locale, proxy, debconf pipe, frontend capabilities and priority,
+     * and whose changes don't contradict each other are combined. Each transaction
+     * still reports the progress and exit status of the combined run.
+     * Prompts for media, untrusted packages and configuration files are
+     * sent to the transaction that started the run.
+     *
+     * If the combined changes can't be marked, or the run is cancelled
+     * before anything is installed, the other transactions run again on
+     * their own.
+     *
+     * This is off by default, and can only be set before the transaction
+     * is run.
+     *
+     * @param coalescable Whether the transaction may be combined with others
+     *
+     * @see isCoalescable
+     * @since 6.0
+     */
+    void setCoalescable(bool coalescable);
+
+    /**
+     * Sets how the downloads of the transaction are queued, overriding
+     * Acquire::Queue-Mode for this transaction only. With "host", there is
+     * a download queue for each host, so that hosts are downloaded from in
+     * parallel. With "access", there is one queue for each access method,
+     * such as http.
+     *
+     * Transactions with download settings of their own run while no other
+     * transaction runs, since the settings apply to the whole worker.
+     *
+     * Download settings can only be set before the transaction is run.
+     *
+     * @param mode "host", "access", or an empty string for the APT
+     * configuration
+     *
+     * @see queueMode
+     * @since 6.0
+     */
+    void setQueueMode(const QString &mode);
+
+    /**
+     * Sets the most downloads the transaction runs at once in the "host"
+     * queue mode, overriding Acquire::QueueHost::Limit for this transaction
+     * only. Each host is downloaded from over one connection.
+     *
+     * @param count Between 1 and 64, or -1 for the APT configuration
+     *
+     * @see setQueueMode
+     * @since 6.0
+     */
+    void setMaxParallelDownloads(int count);
+
+    /**
+     * Sets how many HTTP requests the transaction sends ahead on a
+     * connection, overriding Acquire::http::Pipeline-Depth for this
+     * transaction only. 0 turns pipelining off.
+     *
+     * @param depth Between 0 and 100, or -1 for the APT configuration
+     *
+     * @see setQueueMode
+     * @since 6.0
+     */
+    void setPipelineDepth(int depth);
+
+    /**
+     * Sets how often the transaction retries a failed download, overriding
+     * Acquire::Retries for this transaction only.
+     *
+     * @param retries Between 0 and 20, or -1 for the APT configuration
+     *
+     * @see setQueueMode
+     * @since 6.0
+     */
+    void setDownloadRetries(int retries);
+
+    /**
+     * Limits the rate at which the transaction downloads, across all
+     * download methods. Unlike the other download settings, the limit can
+     * be changed at any time before the transaction finishes, and applies
+     * within a second.
+     *
+     * While a transaction of a higher priority is downloading, a
+     * transaction of background priority gets a small fraction of the
+     * bandwidth, whatever its limit.
+     *
+     * @param limit The rate in bytes per second, or 0 for no limit
+     *
+     * @see setPriority
+     * @since 6.0
+     */
+    void setDownloadLimit(quint64 limit);
+
     /**
      * Queues the transaction to be processed by the QApt Worker.
      */
@@ -525,10 +893,30 @@ public Q_SLOTS:
      */
     void resolveConfigFileConflict(const QString &currentPath, bool replace);
 
+    /**
+     * Moves all further communication about the transaction from the system
+     * bus to a private connection with the QApt Worker. Progress updates and
+     * other signals then no longer pass through the system bus daemon,
+     * which saves CPU time during large transactions.
+     *
+     * The system bus is still used to start the worker and to authorize
+     * the transaction. This should be called before run().
+     *
+     * This is a blocking call to the worker.
+     *
+     * @return @c true if the transaction now uses a private connection,
+     * @c false if the system bus continues to be used
+     *
+     * @since 6.0
+     */
+    bool usePeerConnection();
+
 private Q_SLOTS:
     void sync();
     void updateProperty(int type, const QDBusVariant &variant);
+    void updateProperties(const QVariantMap &changes);
     void onCallFinished(QDBusPendingCallWatcher *watcher);
+    void onResyncFinished(QDBusPendingCallWatcher *watcher);
     void serviceOwnerChanged(QString name, QString oldOwner, QString newOwner);
     void emitFinished(int exitStatus);
 };
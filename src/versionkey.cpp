@@ -0,0 +1,221 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "versionkey.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace QApt {
+
+namespace {
+
+// The key is a sequence of 16 bit big-endian weights, interleaved with the
+// numeric parts of the version. The weights are spread out so that an
+// empty fragment sorts in between a tilde and everything else, just like
+// in APT.
+enum : quint16 {
+    TildeWeight = 2,
+    EmptyFragmentWeight = 3,
+    RunEndWeight = 4
+};
+
+inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline bool isAlpha(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// Character order as used by debVersioningSystem::CmpFragment()
+inline int order(char c)
+{
+    if (isDigit(c)) {
+        return 0;
+    } else if (isAlpha(c)) {
+        return c;
+    } else if (c == '~') {
+        return -1;
+    } else if (c) {
+        return c + 256;
+    }
+
+    return 0;
+}
+
+inline void appendWeight(QByteArray &key, int weight)
+{
+    key.append(char(weight >> 8));
+    key.append(char(weight & 0xFF));
+}
+
+void appendFragment(QByteArray &key, const char *begin, const char *end)
+{
+    if (begin == end) {
+        appendWeight(key, EmptyFragmentWeight);
+        return;
+    }
+
+    const char *p = begin;
+    while (p != end) {
+        // Non-digit run, compared character by character. Its end compares
+        // like a digit, i.e. after '~' but before anything else.
+        while (p != end && !isDigit(*p)) {
+            appendWeight(key, (order(*p) + 2) * 2);
+            ++p;
+        }
+        appendWeight(key, RunEndWeight);
+
+        // Digit run, compared numerically by length and then by digits
+        while (p != end && *p == '0') {
+            ++p;
+        }
+
+        const char *digits = p;
+        while (p != end && isDigit(*p)) {
+            ++p;
+        }
+
+        appendWeight(key, std::min<int>(p - digits, 0xFFFF));
+        key.append(digits, p - digits);
+    }
+
+    // The end of a fragment compares like an empty non-digit run
+    appendWeight(key, RunEndWeight);
+}
+
+}
+
+VersionKey::VersionKey()
+{
+}
+
+VersionKey::VersionKey(const QString &version)
+    : m_version(version)
+{
+    const QByteArray data = version.toUtf8();
+    const char *begin = data.constData();
+    const char *end = begin + data.size();
+
+    m_key.reserve(data.size() * 3 + 16);
+
+    // Split the version the same way debVersioningSystem::DoCmpVersion()
+    // does. A zero epoch is the same as no epoch.
+    const char *epochBegin = begin;
+    const char *epochEnd = static_cast<const char *>(memchr(begin, ':', end - begin));
+    if (!epochEnd) {
+        epochEnd = begin;
+    }
+
+    const char *upstreamBegin = epochEnd;
+    if (epochEnd != begin) {
+        while (*epochBegin == '0') {
+            ++epochBegin;
+        }
+        upstreamBegin = epochEnd + 1;
+        if (epochBegin == epochEnd) {
+            epochBegin = epochEnd = upstreamBegin;
+        }
+    }
+
+    appendFragment(m_key, epochBegin, epochEnd);
+
+    const char *upstreamEnd = static_cast<const char *>(memrchr(upstreamBegin, '-', end - upstreamBegin));
+    const bool hasRevision = upstreamEnd && upstreamEnd != upstreamBegin;
+    if (!upstreamEnd) {
+        upstreamEnd = end;
+    }
+
+    appendFragment(m_key, upstreamBegin, upstreamEnd);
+
+    // No Debian revision is treated like -0
+    if (hasRevision) {
+        appendFragment(m_key, upstreamEnd + 1, end);
+    } else {
+        static const char zero[] = "0";
+        appendFragment(m_key, zero, zero + 1);
+    }
+
+    m_key.squeeze();
+}
+
+QString VersionKey::version() const
+{
+    return m_version;
+}
+
+bool VersionKey::isNull() const
+{
+    return m_key.isEmpty();
+}
+
+int VersionKey::compare(const VersionKey &other) const
+{
+    const int size = std::min(m_key.size(), other.m_key.size());
+    const int result = memcmp(m_key.constData(), other.m_key.constData(), size);
+    if (result != 0) {
+        return result;
+    }
+
+    return m_key.size() - other.m_key.size();
+}
+
+void VersionKey::sort(QList<VersionKey> &keys)
+{
+    std::stable_sort(keys.begin(), keys.end());
+}
+
+QStringList VersionKey::sortByVersion(const QStringList &versions)
+{
+    QList<VersionKey> keys;
+    keys.reserve(versions.size());
+    for (const QString &version : versions) {
+        keys.append(VersionKey(version));
+    }
+
+    sort(keys);
+
+    QStringList sorted;
+    sorted.reserve(keys.size());
+    for (const VersionKey &key : std::as_const(keys)) {
+        sorted.append(key.m_version);
+    }
+
+    return sorted;
+}
+
+QStringList VersionKey::newerThan(const QStringList &versions, const QString &version)
+{
+    const VersionKey reference(version);
+    QStringList newer;
+
+    for (const QString &candidate : versions) {
+        if (VersionKey(candidate) > reference) {
+            newer.append(candidate);
+        }
+    }
+
+    return newer;
+}
+
+}
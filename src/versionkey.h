@@ -0,0 +1,114 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef QAPT_VERSIONKEY_H
+#define QAPT_VERSIONKEY_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+namespace QApt {
+
+/**
+ * The VersionKey class holds a Debian version string that has been
+ * pre-tokenized into epoch, upstream version and Debian revision once, and
+ * encoded into a compact form that compares with a plain memory comparison.
+ *
+ * The ordering of VersionKeys is identical to that of APT's Debian
+ * versioning system, as used by Package::compareVersion(). When a version
+ * has to be compared more than once, e.g. when sorting a list of versions,
+ * creating VersionKeys up front is considerably cheaper than repeatedly
+ * calling Package::compareVersion().
+ *
+ * @since 6.0
+ */
+class Q_DECL_EXPORT VersionKey
+{
+public:
+   /**
+    * Default constructor. Creates a null key that sorts before any
+    * non-null key.
+    */
+    VersionKey();
+
+   /**
+    * Tokenizes the given Debian version string.
+    *
+    * @param version The version to create a key for
+    */
+    explicit VersionKey(const QString &version);
+
+   /**
+    * Returns the version string the key was created from.
+    */
+    QString version() const;
+
+   /**
+    * Returns whether the key was default-constructed.
+    */
+    bool isNull() const;
+
+   /**
+    * Compares this key with @p other and returns an integer less than,
+    * equal to, or greater than zero if this version is less than, equal to,
+    * or greater than the other version.
+    */
+    int compare(const VersionKey &other) const;
+
+    bool operator==(const VersionKey &other) const { return compare(other) == 0; }
+    bool operator!=(const VersionKey &other) const { return compare(other) != 0; }
+    bool operator<(const VersionKey &other) const { return compare(other) < 0; }
+    bool operator<=(const VersionKey &other) const { return compare(other) <= 0; }
+    bool operator>(const VersionKey &other) const { return compare(other) > 0; }
+    bool operator>=(const VersionKey &other) const { return compare(other) >= 0; }
+
+   /**
+    * Sorts @p keys in ascending version order. Equal versions keep their
+    * relative order.
+    */
+    static void sort(QList<VersionKey> &keys);
+
+   /**
+    * Returns @p versions sorted in ascending version order. Equal versions
+    * keep their relative order.
+    */
+    static QStringList sortByVersion(const QStringList &versions);
+
+   /**
+    * Returns the versions out of @p versions that are newer than
+    * @p version, in their original order.
+    *
+    * This is useful e.g. for picking the changelog entries that are newer
+    * than the installed version.
+    */
+    static QStringList newerThan(const QStringList &versions, const QString &version);
+
+private:
+    QString m_version;
+    QByteArray m_key;
+};
+
+}
+
+Q_DECLARE_TYPEINFO(QApt::VersionKey, Q_MOVABLE_TYPE);
+
+#endif
@@ -22,18 +22,40 @@
 
 #include <apt-pkg/error.h>
 #include <QDebug>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
 #include <unistd.h> 
 
+struct SharedLock {
+    int fd;
+    int holders;
+};
+
+// Process-wide lock files, keyed by directory
+static QMutex s_sharedLocksMutex;
+static QHash<QByteArray, SharedLock> s_sharedLocks;
+
 AptLock::AptLock(const QString &path)
     : m_path(path.toUtf8())
-    , m_fd(-1)
+    , m_isLocked(false)
+    , m_notifyFd(-1)
+{
+}
+
+AptLock::~AptLock()
 {
+    release();
+    stopWatching();
 }
 
 bool AptLock::isLocked() const
 {
-    return m_fd != -1;
+    return m_isLocked;
 }
 
 bool AptLock::acquire()
@@ -41,11 +63,24 @@ bool AptLock::acquire()
     if (isLocked())
         return true;
 
-    std::string str = m_path.data();
-    m_fd = GetLock(str + "lock");
-    m_lock.Fd(m_fd);
+    QMutexLocker locker(&s_sharedLocksMutex);
+    SharedLock &shared = s_sharedLocks[m_path];
 
-    return isLocked();
+    if (!shared.holders) {
+        std::string str = m_path.data();
+        shared.fd = GetLock(str + "lock");
+
+        if (shared.fd == -1) {
+            s_sharedLocks.remove(m_path);
+            return false;
+        }
+    }
+
+    ++shared.holders;
+    m_isLocked = true;
+    stopWatching();
+
+    return true;
 }
 
 void AptLock::release()
@@ -53,7 +88,99 @@ void AptLock::release()
     if (!isLocked())
         return;
 
-    m_lock.Close();
-    ::close(m_fd);
-    m_fd = -1;
+    QMutexLocker locker(&s_sharedLocksMutex);
+    SharedLock &shared = s_sharedLocks[m_path];
+
+    if (--shared.holders <= 0) {
+        ::close(shared.fd);
+        s_sharedLocks.remove(m_path);
+    }
+
+    m_isLocked = false;
+}
+
+void AptLock::waitForRelease(int timeout)
+{
+    const QByteArray lockFile = m_path + "lock";
+
+    if (m_notifyFd == -1) {
+        m_notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+        const uint32_t mask = IN_CLOSE_WRITE | IN_CLOSE_NOWRITE | IN_ATTRIB |
+                              IN_DELETE_SELF | IN_MOVE_SELF;
+        if (m_notifyFd != -1 && inotify_add_watch(m_notifyFd, lockFile.constData(), mask) == -1)
+            stopWatching();
+
+        // Fall back to plain polling
+        if (m_notifyFd == -1) {
+            usleep(timeout * 1000);
+            return;
+        }
+    } else {
+        // Drop the events caused by our own attempts to take the lock
+        char buffer[4096];
+        while (read(m_notifyFd, buffer, sizeof(buffer)) > 0) {}
+    }
+
+    pollfd pfd = { m_notifyFd, POLLIN, 0 };
+    if (poll(&pfd, 1, timeout) <= 0)
+        return;
+
+    // Read out what happened, and watch the file anew if it went away
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(m_notifyFd, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t i = 0; i < length;) {
+            const inotify_event *event = reinterpret_cast<const inotify_event *>(buffer + i);
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                stopWatching();
+                return;
+            }
+
+            i += sizeof(inotify_event) + event->len;
+        }
+    }
+}
+
+int AptLock::holderPid() const
+{
+    const QByteArray lockFile = m_path + "lock";
+    int fd = ::open(lockFile.constData(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return 0;
+
+    struct flock fl = {};
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+
+    int pid = 0;
+    if (fcntl(fd, F_GETLK, &fl) == 0 && fl.l_type != F_UNLCK && fl.l_pid > 0)
+        pid = fl.l_pid;
+
+    ::close(fd);
+
+    return pid;
+}
+
+QString AptLock::processCommand(int pid)
+{
+    if (pid <= 0)
+        return QString();
+
+    // Only the name, since the arguments of another user's process are
+    // nobody else's business and may well carry secrets
+    QFile comm(QLatin1String("/proc/") + QString::number(pid) + QLatin1String("/comm"));
+    if (comm.open(QIODevice::ReadOnly))
+        return QString::fromLocal8Bit(comm.readAll().trimmed());
+
+    return QString();
+}
+
+void AptLock::stopWatching()
+{
+    if (m_notifyFd == -1)
+        return;
+
+    ::close(m_notifyFd);
+    m_notifyFd = -1;
 }
@@ -25,19 +25,49 @@
 
 #include <apt-pkg/fileutl.h>
 
+/**
+ * A lock on an APT directory.
+ *
+ * The underlying fcntl() lock belongs to the whole process, and closing any
+ * descriptor of the lock file drops it. Locks on the same directory are
+ * therefore shared by all AptLock objects of the worker: the file is locked
+ * by the first acquire() and unlocked after the last release().
+ */
 class AptLock
 {
 public:
     AptLock(const QString &path);
+    ~AptLock();
 
     bool isLocked() const;
     bool acquire();
     void release();
 
+    /**
+     * Blocks until the lock file is closed or changed by another process,
+     * which usually means the lock has been released, or until @p timeout
+     * milliseconds have passed.
+     */
+    void waitForRelease(int timeout);
+
+    /**
+     * Returns the process id of the process holding the lock, or 0 if the
+     * lock is free or the holder is unknown.
+     */
+    int holderPid() const;
+
+    /**
+     * Returns the command name of the process with the id @p pid, without
+     * its arguments.
+     */
+    static QString processCommand(int pid);
+
 private:
     QByteArray m_path;
-    int m_fd;
-    FileFd m_lock;
+    bool m_isLocked;
+    int m_notifyFd;
+
+    void stopWatching();
 };
 
 #endif // APTLOCK_H
@@ -43,19 +43,27 @@
 #include <apt-pkg/update.h>
 #include <apt-pkg/upgrade.h>
 #include <apt-pkg/versionmatch.h>
+#include <mutex>
 #include <string>
+#include <vector>
 
 // System includes
+#include <fcntl.h>
 #include <sys/statvfs.h>
 #include <sys/statfs.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #define RAMFS_MAGIC     0x858458f6
+// The fingerprint starts with the binary caches, 7 fields for each
+#define FINGERPRINT_CACHE_FIELDS 14
 
 // Own includes
 #include "aptlock.h"
+#include "transactionscheduler.h"
 #include "cache.h"
 #include "debfile.h"
 #include "package.h"
+#include "streaminginstall.h"
 #include "workeracquire.h"
 #include "workerinstallprogress.h"
 
@@ -131,11 +139,6 @@ AptWorker::~AptWorker()
     qDeleteAll(m_locks);
 }
 
-void AptWorker::quit()
-{
-    thread()->quit();
-}
-
 Transaction *AptWorker::currentTransaction()
 {
     QMutexLocker locker(&m_transMutex);
@@ -148,28 +151,35 @@ quint64 AptWorker::lastActiveTimestamp()
     return m_lastActiveTimestamp;
 }
 
+void AptWorker::initSystem()
+{
+    // The configuration and system are global, and shared by all workers
+    static std::once_flag systemInitialized;
+    std::call_once(systemInitialized, [] {
+        pkgInitConfig(*_config);
+        pkgInitSystem(*_config, _system);
+    });
+}
+
 void AptWorker::init()
 {
     if (m_ready)
         return;
 
-    pkgInitConfig(*_config);
-    pkgInitSystem(*_config, _system);
+    initSystem();
+
     m_cache = new pkgCacheFile;
 
     // Prepare locks to be used later
-    QStringList dirs;
-
-    dirs << QString::fromStdString(_config->FindDir("Dir::Cache::Archives"))
-         << QString::fromStdString(_config->FindDir("Dir::State::lists"));
-
     QString statusFile = QString::fromStdString(_config->FindDir("Dir::State::status"));
     QFileInfo info(statusFile);
-    dirs << info.dir().absolutePath();
 
-    for (const QString &dir : dirs) {
-        m_locks << new AptLock(dir);
-    }
+    m_locks.insert(TransactionScheduler::ListsResource,
+                   new AptLock(QString::fromStdString(_config->FindDir("Dir::State::lists"))));
+    m_locks.insert(TransactionScheduler::ArchivesResource,
+                   new AptLock(QString::fromStdString(_config->FindDir("Dir::Cache::Archives"))));
+    m_locks.insert(TransactionScheduler::StatusResource,
+                   new AptLock(info.dir().absolutePath()));
 
     m_ready = true;
 }
@@ -211,10 +221,18 @@ void AptWorker::runTransaction(Transaction *trans)
     case QApt::InstallFileRole:
         installFile();
         m_dpkgProcess->waitForFinished(-1);
+
+        // Write the cache for the new dpkg status to disk, so that clients
+        // don't have to build it in memory
+        openCache(91, 95);
         break;
     case QApt::DownloadArchivesRole:
         downloadArchives();
         break;
+    case QApt::RebuildCacheRole:
+        // Opening the cache above has written it to disk if it was out of date
+        markDiskCacheChecked();
+        break;
     // Other
     case QApt::EmptyRole:
     default:
@@ -227,23 +245,58 @@ void AptWorker::runTransaction(Transaction *trans)
 
 void AptWorker::cleanupCurrentTransaction()
 {
-    // Well, we're finished now.
-    m_trans->setProgress(100);
-
     // Release locks
     for (AptLock *lock : m_locks) {
         lock->release();
     }
 
+    // Coalesced transactions share the result of the run. If it stopped
+    // early they go back into the queue, unless they were cancelled
+    const QList<Transaction *> members = m_trans->takeCoalesced();
+    const bool interrupted = m_trans->isPreempted() || m_trans->isCancelled();
+
+    for (Transaction *member : members) {
+        if (member->isCancelled()) {
+            member->setProgress(100);
+            member->setExitStatus(QApt::ExitCancelled);
+        } else if (interrupted) {
+            member->requeue();
+        }
+    }
+
+    // A preempted transaction isn't finished, it goes back into the queue
+    if (m_trans->isPreempted()) {
+        m_trans->requeue();
+        m_trans = nullptr;
+
+        QMutexLocker locker(&m_timestampMutex);
+        m_lastActiveTimestamp = QDateTime::currentMSecsSinceEpoch();
+        return;
+    }
+
+    // Well, we're finished now.
+    m_trans->setProgress(100);
+
     // Set transaction exit status
     // This will notify the transaction queue of the transaction's completion
     // as well as mark the transaction for deletion in 5 seconds
+    QApt::ExitStatus exitStatus = QApt::ExitSuccess;
     if (m_trans->isCancelled())
-        m_trans->setExitStatus(QApt::ExitCancelled);
+        exitStatus = QApt::ExitCancelled;
     else if (m_trans->error() != QApt::Success)
-        m_trans->setExitStatus(QApt::ExitFailed);
-    else
-        m_trans->setExitStatus(QApt::ExitSuccess);
+        exitStatus = QApt::ExitFailed;
+
+    if (!interrupted) {
+        for (Transaction *member : members) {
+            if (member->isCancelled())
+                continue;
+
+            member->setProgress(100);
+            member->setExitStatus(exitStatus);
+        }
+    }
+
+    m_trans->setExitStatus(exitStatus);
 
     m_trans = nullptr;
 
@@ -253,22 +306,44 @@ void AptWorker::cleanupCurrentTransaction()
 
 void AptWorker::waitForLocks()
 {
-    for (AptLock *lock : m_locks) {
+    const TransactionScheduler::Resources resources =
+            TransactionScheduler::roleResources((QApt::TransactionRole)m_trans->role());
+
+    // Always lock in the same order, so that we can't deadlock with another
+    // worker or with external tools that do the same
+    for (auto iter = m_locks.constBegin(); iter != m_locks.constEnd(); ++iter) {
+        if (!(resources & iter.key()))
+            continue;
+
+        AptLock *lock = iter.value();
         if (lock->acquire()) {
             qDebug() << "locked?" << lock->isLocked();
             continue;
         }
 
         // Couldn't get lock
+        _error->Discard();
         m_trans->setIsPaused(true);
         m_trans->setStatus(QApt::WaitingLockStatus);
 
+        int holderPid = 0;
         while (!lock->isLocked() && m_trans->isPaused() && !m_trans->isCancelled()) {
-            // Wait 3 seconds and try again
-            sleep(3);
-            lock->acquire();
+            const int pid = lock->holderPid();
+            if (pid != holderPid) {
+                holderPid = pid;
+                m_trans->setLockHolder(pid, AptLock::processCommand(pid));
+            }
+
+            // Retry as soon as the lock file is closed, but wake up regularly
+            // to notice cancellation and locks released without closing
+            lock->waitForRelease(250);
+            if (!lock->acquire())
+                _error->Discard();
         }
 
+        if (holderPid)
+            m_trans->setLockHolder(0, QString());
+
         m_trans->setIsPaused(false);
     }
 }
@@ -276,10 +351,24 @@ void AptWorker::waitForLocks()
 void AptWorker::openCache(int begin, int end)
 {
     m_trans->setStatus(QApt::LoadingCacheStatus);
+
+    const QVector<quint64> fingerprint = cacheFingerprint();
+
+    // Nothing the cache is built from has changed, so the open cache only
+    // needs its marks reset. Init() also reloads the auto-installed flags
+    if (m_records && m_cache->IsDepCacheBuilt() && fingerprint == m_cacheFingerprint) {
+        _error->Discard();
+        if ((*m_cache)->Init(nullptr)) {
+            m_trans->setProgress(end);
+            return;
+        }
+    }
+
     CacheOpenProgress *progress = new CacheOpenProgress(m_trans, begin, end);
 
     // Close in case it's already open
     m_cache->Close();
+    m_cacheFingerprint.clear();
     _error->Discard();
     if (!m_cache->ReadOnlyOpen(progress)) {
         std::string message;
@@ -297,6 +386,93 @@ void AptWorker::openCache(int begin, int end)
     delete progress;
     delete m_records;
     m_records = new pkgRecords(*(m_cache));
+    m_cacheFingerprint = fingerprint;
+}
+
+QVector<quint64> AptWorker::cacheFingerprint() const
+{
+    std::vector<std::string> paths = {
+        _config->FindFile("Dir::Cache::pkgcache"),
+        _config->FindFile("Dir::Cache::srcpkgcache"),
+        _config->FindFile("Dir::State::status"),
+        _config->FindFile("Dir::State::extended_states"),
+        _config->FindDir("Dir::State::lists"),
+        _config->FindFile("Dir::Etc::main"),
+        _config->FindFile("Dir::Etc::sourcelist"),
+        _config->FindFile("Dir::Etc::preferences")
+    };
+
+    // Editing a file in place doesn't change the times of its directory,
+    // so the entries of the fragment directories are looked at one by one
+    const std::string partsDirs[] = {
+        _config->FindDir("Dir::Etc::parts"),
+        _config->FindDir("Dir::Etc::sourceparts"),
+        _config->FindDir("Dir::Etc::preferencesparts")
+    };
+
+    for (const std::string &dir : partsDirs) {
+        if (dir.empty())
+            continue;
+
+        paths.push_back(dir);
+
+        const QString dirPath = QString::fromStdString(dir);
+        const QStringList entries = QDir(dirPath).entryList(QDir::Files, QDir::Name);
+        for (const QString &entry : entries)
+            paths.push_back(QString(dirPath % entry).toStdString());
+    }
+
+    QVector<quint64> fingerprint;
+    for (const std::string &path : paths) {
+        struct stat info;
+        if (path.empty() || stat(path.c_str(), &info) != 0) {
+            fingerprint << 0 << 0 << 0 << 0 << 0 << 0 << 0;
+            continue;
+        }
+
+        // Files are usually replaced by renaming, which changes the inode,
+        // while directories change their times when entries come and go
+        fingerprint << info.st_dev << info.st_ino << info.st_size
+                    << info.st_mtim.tv_sec << info.st_mtim.tv_nsec
+                    << info.st_ctim.tv_sec << info.st_ctim.tv_nsec;
+    }
+
+    return fingerprint;
+}
+
+void AptWorker::markDiskCacheChecked()
+{
+    const std::string cachePath = _config->FindFile("Dir::Cache::pkgcache");
+
+    struct stat info;
+    if (cachePath.empty() || stat(cachePath.c_str(), &info) != 0)
+        return;
+
+    // An update or a commit running alongside may have changed what the
+    // cache is built from since it was opened. The cache has to keep
+    // looking out of date then
+    auto sourcesUnchanged = [this]() {
+        return cacheFingerprint().mid(FINGERPRINT_CACHE_FIELDS) ==
+               m_cacheFingerprint.mid(FINGERPRINT_CACHE_FIELDS);
+    };
+
+    if (m_cacheFingerprint.isEmpty() || !sourcesUnchanged())
+        return;
+
+    // Clients take a cache that is older than its sources for out of date,
+    // but APT doesn't rewrite a cache that is still valid
+    if (utimensat(AT_FDCWD, cachePath.c_str(), nullptr, 0) != 0)
+        return;
+
+    // Changed right before the touch, which would hide it
+    if (!sourcesUnchanged()) {
+        const struct timespec times[] = { info.st_atim, info.st_mtim };
+        utimensat(AT_FDCWD, cachePath.c_str(), times, 0);
+        return;
+    }
+
+    // Touching the cache doesn't make it any different
+    m_cacheFingerprint = cacheFingerprint();
 }
 
 void AptWorker::updateCache()
@@ -309,7 +485,7 @@ void AptWorker::updateCache()
 
     // Fetch the lists.
     if (!ListUpdate(*acquire, *m_cache->GetSourceList())) {
-        if (!m_trans->isCancelled()) {
+        if (!m_trans->isCancelled() && !m_trans->isPreempted()) {
             m_trans->setError(QApt::FetchError);
 
             std::string message;
@@ -322,17 +498,49 @@ void AptWorker::updateCache()
     // Clean up
     delete acquire;
 
+    if (m_trans->isPreempted())
+        return;
+
     openCache(91, 95);
 }
 
 bool AptWorker::markChanges()
 {
-    pkgDepCache::ActionGroup *actionGroup = new pkgDepCache::ActionGroup(*m_cache);
+    QString errorDetails;
+    QApt::ErrorCode error = markPackages(m_cache, m_trans->coalescedPackages(), &errorDetails);
+
+    // The changes of coalesced transactions don't go together. Hand the
+    // members back to the queue, and make the changes of this one alone
+    if (error != QApt::Success && !m_trans->coalesced().isEmpty()) {
+        for (Transaction *member : m_trans->takeCoalesced())
+            member->requeue();
+
+        _error->Discard();
+        errorDetails.clear();
+        (*m_cache)->Init(nullptr);
+        error = markPackages(m_cache, m_trans->packages(), &errorDetails);
+    }
 
-    auto mapIter = m_trans->packages().constBegin();
+    if (error != QApt::Success) {
+        m_trans->setError(error);
+        if (!errorDetails.isEmpty())
+            m_trans->setErrorDetails(errorDetails);
+
+        return false;
+    }
+
+    return true;
+}
+
+QApt::ErrorCode AptWorker::markPackages(pkgCacheFile *cache, const QVariantMap &packages,
+                                        QString *errorDetails)
+{
+    pkgDepCache::ActionGroup *actionGroup = new pkgDepCache::ActionGroup(*cache);
+
+    auto mapIter = packages.constBegin();
 
     QApt::Package::State operation = QApt::Package::ToKeep;
-    while (mapIter != m_trans->packages().constEnd()) {
+    while (mapIter != packages.constEnd()) {
         operation = (QApt::Package::State)mapIter.value().toInt();
 
         // Find package in cache
@@ -343,56 +551,55 @@ bool AptWorker::markChanges()
         // Check if a version is specified
         if (packageString.contains(QLatin1Char(','))) {
             QStringList split = packageString.split(QLatin1Char(','));
-            iter = (*m_cache)->FindPkg(split.at(0).toStdString());
+            iter = (*cache)->FindPkg(split.at(0).toStdString());
             version = split.at(1);
         } else {
-            iter = (*m_cache)->FindPkg(packageString.toStdString());
+            iter = (*cache)->FindPkg(packageString.toStdString());
         }
 
         // Check if the package was found
         if (iter == 0) {
-            m_trans->setError(QApt::NotFoundError);
-            m_trans->setErrorDetails(packageString);
+            *errorDetails = packageString;
 
             delete actionGroup;
-            return false;
+            return QApt::NotFoundError;
         }
 
-        pkgDepCache::StateCache &State = (*m_cache)[iter];
-        pkgProblemResolver resolver(*m_cache);
+        pkgDepCache::StateCache &State = (*cache)[iter];
+        pkgProblemResolver resolver(*cache);
         bool toPurge = false;
 
         // Then mark according to the instruction
         switch (operation) {
         case QApt::Package::Held:
-            (*m_cache)->MarkKeep(iter, false);
-            (*m_cache)->SetReInstall(iter, false);
+            (*cache)->MarkKeep(iter, false);
+            (*cache)->SetReInstall(iter, false);
             resolver.Protect(iter);
             break;
         case QApt::Package::ToUpgrade: {
             bool fromUser = !(State.Flags & pkgCache::Flag::Auto);
-            (*m_cache)->MarkInstall(iter, true, 0, fromUser);
+            (*cache)->MarkInstall(iter, true, 0, fromUser);
 
             resolver.Clear(iter);
             resolver.Protect(iter);
             break;
         }
         case QApt::Package::ToInstall:
-            (*m_cache)->MarkInstall(iter, true);
+            (*cache)->MarkInstall(iter, true);
 
             resolver.Clear(iter);
             resolver.Protect(iter);
             break;
         case QApt::Package::ToReInstall:
-            (*m_cache)->SetReInstall(iter, true);
+            (*cache)->SetReInstall(iter, true);
             break;
         case QApt::Package::ToDowngrade: {
             pkgVersionMatch Match(version.toStdString(), pkgVersionMatch::Version);
             pkgCache::VerIterator Ver = Match.Find(iter);
 
-            (*m_cache)->SetCandidateVersion(Ver);
+            (*cache)->SetCandidateVersion(Ver);
 
-            (*m_cache)->MarkInstall(iter, true);
+            (*cache)->MarkInstall(iter, true);
 
             resolver.Clear(iter);
             resolver.Protect(iter);
@@ -401,8 +608,8 @@ bool AptWorker::markChanges()
         case QApt::Package::ToPurge:
             toPurge = true;
         case QApt::Package::ToRemove:
-            (*m_cache)->SetReInstall(iter, false);
-            (*m_cache)->MarkDelete(iter, toPurge);
+            (*cache)->SetReInstall(iter, false);
+            (*cache)->MarkDelete(iter, toPurge);
 
             resolver.Clear(iter);
             resolver.Protect(iter);
@@ -415,21 +622,20 @@ bool AptWorker::markChanges()
 
     delete actionGroup;
 
-    if (_error->PendingError() && ((*m_cache)->BrokenCount() == 0))
+    if (_error->PendingError() && ((*cache)->BrokenCount() == 0))
         _error->Discard(); // We had dep errors, but fixed them
 
     if (_error->PendingError())
     {
         // We've failed to mark the packages
-        m_trans->setError(QApt::MarkingError);
         std::string message;
         if (_error->PopMessage(message))
-            m_trans->setErrorDetails(QString::fromStdString(message));
+            *errorDetails = QString::fromStdString(message);
 
-        return false;
+        return QApt::MarkingError;
     }
 
-    return true;
+    return QApt::Success;
 }
 
 void AptWorker::upgradeSystem()
@@ -444,6 +650,10 @@ void AptWorker::upgradeSystem()
 
 void AptWorker::commitChanges()
 {
+    // Declared before the fetcher, which has to go first
+    StreamingInstall streamingInstall(m_trans, m_cache, m_records);
+    const bool streaming = m_trans->streamingInstall() && streamingInstall.plan();
+
     // Initialize fetcher with our progress watcher
     WorkerAcquire *acquire = new WorkerAcquire(this, 15, 50);
     acquire->setTransaction(m_trans);
@@ -454,8 +664,15 @@ void AptWorker::commitChanges()
     packageManager = _system->CreatePM(*m_cache);
 
     // Populate the fetcher with the needed archives
-    if (!packageManager->GetArchives(&fetcher, m_cache->GetSourceList(), m_records) ||
-        _error->PendingError()) {
+    bool queued;
+    if (streaming) {
+        queued = streamingInstall.queueArchives(&fetcher);
+        acquire->setStreamingInstall(&streamingInstall);
+    } else {
+        queued = packageManager->GetArchives(&fetcher, m_cache->GetSourceList(), m_records);
+    }
+
+    if (!queued || _error->PendingError()) {
         m_trans->setError(QApt::FetchError);
         delete acquire;
         return;
@@ -505,8 +722,7 @@ void AptWorker::commitChanges()
             m_trans->setUntrustedPackages(untrustedPackages, allowUntrusted);
 
             // Wait until the user approves, disapproves, or cancels the transaction
-            while (m_trans->isPaused())
-                 usleep(200000);
+            m_trans->waitWhilePaused();
         }
 
         if (!m_trans->allowUntrusted()) {
@@ -517,11 +733,28 @@ void AptWorker::commitChanges()
         }
     }
 
+    if (streaming) {
+        // Installs batches as their archives come in
+        fetcher.Run();
+        delete acquire;
+
+        if (!streamingInstall.hasStarted() &&
+            (m_trans->isCancelled() || m_trans->isPreempted())) {
+            return;
+        }
+
+        // Installs the remaining batches. Errors are set by streamingInstall
+        streamingInstall.finish(&fetcher);
+
+        openCache(91, 95);
+        return;
+    }
+
     // Fetch archives from the network
     if (fetcher.Run() != pkgAcquire::Continue) {
         // Our fetcher will report warnings for itself, but if it fails entirely
         // we have to send the error and finished signals
-        if (!m_trans->isCancelled()) {
+        if (!m_trans->isCancelled() && !m_trans->isPreempted()) {
             m_trans->setError(QApt::FetchError);
         }
 
@@ -531,8 +764,9 @@ void AptWorker::commitChanges()
 
     delete acquire;
 
-    // Check for cancellation during fetch, or fetch errors
-    if (m_trans->isCancelled())
+    // Check for cancellation or preemption during fetch, or fetch errors.
+    // Coalesced transactions may have been cancelled after the last pulse
+    if (m_trans->isCancelled() || m_trans->preemptIfRequested())
         return;
 
     bool failed = false;
@@ -554,7 +788,6 @@ void AptWorker::commitChanges()
     // Set up the install
     WorkerInstallProgress installProgress(50, 90);
     installProgress.setTransaction(m_trans);
-    setenv("PATH", "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin", 1);
 
     pkgPackageManager::OrderResult res = installProgress.start(packageManager);
     bool success = (res == pkgPackageManager::Completed);
@@ -619,7 +852,7 @@ void AptWorker::downloadArchives()
     if (fetcher.Run() != pkgAcquire::Continue) {
         // Our fetcher will report warnings for itself, but if it fails entirely
         // we have to send the error and finished signals
-        if (!m_trans->isCancelled()) {
+        if (!m_trans->isCancelled() && !m_trans->isPreempted()) {
             m_trans->setError(QApt::FetchError);
         }
     }
@@ -632,13 +865,6 @@ void AptWorker::installFile()
 {
     m_trans->setStatus(QApt::RunningStatus);
 
-    // FIXME: bloody workaround.
-    //        setTransaction contains logic WRT locale and debconf setup, which
-    //        is also useful to dpkg. For now simply reuse WorkerInstallProgress
-    //        as it has no adverse effects.
-    WorkerInstallProgress installProgress(50, 90);
-    installProgress.setTransaction(m_trans);
-
     QApt::DebFile deb(m_trans->filePath());
 
     QString debArch = deb.architecture();
@@ -659,12 +885,19 @@ void AptWorker::installFile()
     m_dpkgProcess = new QProcess(this);
     QString program = QLatin1String("dpkg") %
             QLatin1String(" -i ") % '"' % m_trans->filePath() % '"';
-    setenv("PATH", "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin", 1);
-    setenv("DEBIAN_FRONTEND", "passthrough", 1);
-    setenv("DEBCONF_PIPE", "/tmp/qapt-sock", 1);
+
+    // Only for dpkg, the environment of the worker is shared
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert(QLatin1String("DEBIAN_FRONTEND"), QLatin1String("passthrough"));
+    environment.insert(QLatin1String("DEBCONF_PIPE"), QLatin1String("/tmp/qapt-sock"));
+    m_dpkgProcess->setProcessEnvironment(environment);
+    m_dpkgErrors.clear();
     m_dpkgProcess->start(program);
     connect(m_dpkgProcess, SIGNAL(started()), this, SLOT(dpkgStarted()));
-    connect(m_dpkgProcess, SIGNAL(readyRead()), this, SLOT(updateDpkgProgress()));
+    connect(m_dpkgProcess, SIGNAL(readyReadStandardOutput()), this, SLOT(updateDpkgProgress()));
+    // Forwarded as it comes, so that the terminal log keeps the order of
+    // the output
+    connect(m_dpkgProcess, SIGNAL(readyReadStandardError()), this, SLOT(updateDpkgErrors()));
     connect(m_dpkgProcess, SIGNAL(finished(int,QProcess::ExitStatus)),
             this, SLOT(dpkgFinished(int,QProcess::ExitStatus)));
 }
@@ -676,18 +909,38 @@ void AptWorker::dpkgStarted()
 
 void AptWorker::updateDpkgProgress()
 {
-    QString str = m_dpkgProcess->readLine();
+    const QByteArray output = m_dpkgProcess->readAllStandardOutput();
+    if (output.isEmpty())
+        return;
 
-    m_trans->setStatusDetails(str);
+    m_trans->appendTerminalOutput(output);
+
+    // Show the most recent line
+    const QList<QByteArray> lines = output.trimmed().split('\n');
+    if (!lines.last().isEmpty())
+        m_trans->setStatusDetails(QString::fromLocal8Bit(lines.last()));
+}
+
+void AptWorker::updateDpkgErrors()
+{
+    const QByteArray errors = m_dpkgProcess->readAllStandardError();
+    m_trans->appendTerminalOutput(errors);
+    m_dpkgErrors += errors;
 }
 
 void AptWorker::dpkgFinished(int exitCode, QProcess::ExitStatus exitStatus)
 {
+    // Whatever is left after the last notification
+    updateDpkgProgress();
+    updateDpkgErrors();
+
     if (exitCode != 0 || exitStatus != QProcess::NormalExit) {
         m_trans->setError(QApt::CommitError);
-        m_trans->setErrorDetails(m_dpkgProcess->readAllStandardError());
+        m_trans->setErrorDetails(m_dpkgErrors);
     }
 
+    m_dpkgErrors.clear();
+
     m_dpkgProcess->deleteLater();
     m_dpkgProcess = nullptr;
 }
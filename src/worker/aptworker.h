@@ -21,10 +21,14 @@
 #ifndef APTWORKER_H
 #define APTWORKER_H
 
+#include <QMap>
 #include <QMutex>
 #include <QProcess>
+#include <QVariantMap>
 #include <QVector>
 
+#include "globals.h"
+
 class QProcess;
 
 class pkgCacheFile;
@@ -43,21 +47,44 @@ public:
     Transaction *currentTransaction();
     quint64 lastActiveTimestamp();
 
+    /**
+     * Initializes the APT configuration and system, which are shared by
+     * everything in the worker that uses the package system. Only the first
+     * call does anything.
+     */
+    static void initSystem();
+
+    /**
+     * Marks the changes in @p packages, which maps package names to the
+     * QApt::Package::State they should get, like the packages of a
+     * transaction.
+     *
+     * @return QApt::Success, or the error that kept the changes from being
+     * marked, with details in @p errorDetails
+     */
+    static QApt::ErrorCode markPackages(pkgCacheFile *cache, const QVariantMap &packages,
+                                        QString *errorDetails);
+
 private:
     pkgCacheFile *m_cache;
     pkgRecords *m_records;
     QMutex m_transMutex;
     Transaction *m_trans;
     bool m_ready;
-    QVector<AptLock *> m_locks;
+    // Keyed by TransactionScheduler::Resource, which is also the order
+    // the locks are taken in
+    QMap<int, AptLock *> m_locks;
     QMutex m_timestampMutex;
     quint64 m_lastActiveTimestamp;
     QProcess *m_dpkgProcess;
+    // What dpkg wrote to stderr, for the error details
+    QByteArray m_dpkgErrors;
+    QVector<quint64> m_cacheFingerprint;
 
     /**
-     * If the locks on the package system cannot be immediately taken, this
-     * function will wait until the package system is unlocked, and proceed
-     * to lock it.
+     * Takes the locks on the parts of the package system that the current
+     * transaction's role uses. If they cannot be immediately taken, this
+     * function will wait until they are unlocked, and proceed to lock them.
      */
     void waitForLocks();
 
@@ -67,10 +94,25 @@ private:
     void cleanupCurrentTransaction();
 
     /**
-     * Builds the package cache and package records.
+     * Builds the package cache and package records. If the files the cache
+     * is built from are unchanged since the last time, the already open
+     * cache is kept and only its marking state is reset.
      */
     void openCache(int begin = 0, int end = 5);
 
+    /**
+     * Returns the identity, size and modification times of every file and
+     * directory the package cache depends on.
+     */
+    QVector<quint64> cacheFingerprint() const;
+
+    /**
+     * Updates the modification time of the package cache on disk once it
+     * has been found valid, see BackendPrivate::isDiskCacheStale(). Leaves
+     * it alone if what the cache is built from changed since it was opened.
+     */
+    void markDiskCacheChecked();
+
     /**
      * Checks for and downloads new package source lists.
      */
@@ -118,15 +160,10 @@ public slots:
      */
     void runTransaction(Transaction *trans);
 
-    /**
-     * Stops the separate thread that AptWorker lives in. Call this before
-     * exit to prevent the thread from whining that it was destroyed on shutdown.
-     */
-    void quit();
-
 private slots:
     void dpkgStarted();
     void updateDpkgProgress();
+    void updateDpkgErrors();
     void dpkgFinished(int exitCode, QProcess::ExitStatus exitStatus);
 };
 
@@ -0,0 +1,203 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "archiveprefetcher.h"
+
+// Qt includes
+#include <QDebug>
+
+// Apt-pkg includes
+#include <apt-pkg/acquire.h>
+#include <apt-pkg/acquire-item.h>
+#include <apt-pkg/cachefile.h>
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/error.h>
+#include <apt-pkg/packagemanager.h>
+#include <apt-pkg/pkgrecords.h>
+#include <apt-pkg/pkgsystem.h>
+#include <apt-pkg/upgrade.h>
+
+// System includes
+#include <sys/statvfs.h>
+
+// Own includes
+#include "aptlock.h"
+#include "aptworker.h"
+#include "bandwidthlimiter.h"
+
+// Space to leave free for the packages being installed meanwhile
+#define PREFETCH_SPACE_RESERVE (512ULL * 1024 * 1024)
+
+class PrefetchAcquire : public pkgAcquireStatus
+{
+public:
+    PrefetchAcquire(ArchivePrefetcher *prefetcher, const QString &tid)
+        : m_prefetcher(prefetcher)
+        , m_tid(tid)
+    {
+    }
+
+    bool Pulse(pkgAcquire *Owner)
+    {
+        pkgAcquireStatus::Pulse(Owner);
+        m_limiter.pulse(Owner, m_prefetcher->downloadLimit(m_tid));
+
+        return !m_prefetcher->isCancelled(m_tid);
+    }
+
+    void Stop()
+    {
+        m_limiter.resume();
+        pkgAcquireStatus::Stop();
+    }
+
+    bool MediaChange(std::string, std::string)
+    {
+        // Nobody to ask, the transaction will prompt when it runs
+        return false;
+    }
+
+private:
+    ArchivePrefetcher *m_prefetcher;
+    QString m_tid;
+    BandwidthLimiter m_limiter;
+};
+
+ArchivePrefetcher::ArchivePrefetcher(QObject *parent)
+    : QObject(parent)
+    , m_lock(nullptr)
+    , m_downloadLimit(0)
+{
+}
+
+ArchivePrefetcher::~ArchivePrefetcher()
+{
+    delete m_lock;
+}
+
+void ArchivePrefetcher::cancel(const QString &tid)
+{
+    QMutexLocker locker(&m_cancelMutex);
+
+    m_cancelledTid = tid;
+}
+
+bool ArchivePrefetcher::isCancelled(const QString &tid)
+{
+    QMutexLocker locker(&m_cancelMutex);
+
+    return m_cancelledTid == tid;
+}
+
+void ArchivePrefetcher::setDownloadLimit(const QString &tid, quint64 limit)
+{
+    QMutexLocker locker(&m_cancelMutex);
+
+    m_limitTid = tid;
+    m_downloadLimit = limit;
+}
+
+quint64 ArchivePrefetcher::downloadLimit(const QString &tid)
+{
+    QMutexLocker locker(&m_cancelMutex);
+
+    return (m_limitTid == tid) ? m_downloadLimit : 0;
+}
+
+void ArchivePrefetcher::prefetch(const QString &tid, int role, const QVariantMap &packages,
+                                 bool safeUpgrade)
+{
+    if (!isCancelled(tid)) {
+        AptWorker::initSystem();
+
+        if (!m_lock)
+            m_lock = new AptLock(QString::fromStdString(_config->FindDir("Dir::Cache::Archives")));
+
+        // Shared with a worker of this process that holds the lock, but
+        // not with other package managers
+        if (m_lock->acquire()) {
+            fetchArchives(tid, role, packages, safeUpgrade);
+            m_lock->release();
+        }
+
+        // Whatever went wrong is for the transaction to report when it runs
+        _error->Discard();
+    }
+
+    m_cancelMutex.lock();
+    const bool cancelled = (m_cancelledTid == tid);
+    if (cancelled)
+        m_cancelledTid.clear();
+    m_cancelMutex.unlock();
+
+    emit finished(tid, cancelled);
+}
+
+void ArchivePrefetcher::fetchArchives(const QString &tid, int role, const QVariantMap &packages,
+                                      bool safeUpgrade)
+{
+    // The dpkg status changes between prefetches, so start from scratch
+    pkgCacheFile cache;
+    if (!cache.ReadOnlyOpen(nullptr))
+        return;
+
+    if (role == QApt::UpgradeSystemRole) {
+        if (safeUpgrade)
+            APT::Upgrade::Upgrade(cache, APT::Upgrade::FORBID_REMOVE_PACKAGES | APT::Upgrade::FORBID_INSTALL_NEW_PACKAGES);
+        else
+            APT::Upgrade::Upgrade(cache, APT::Upgrade::ALLOW_EVERYTHING);
+    } else {
+        QString errorDetails;
+        if (AptWorker::markPackages(&cache, packages, &errorDetails) != QApt::Success)
+            return;
+    }
+
+    pkgRecords records(cache);
+    PrefetchAcquire status(this, tid);
+    pkgAcquire fetcher(&status);
+
+    pkgPackageManager *packageManager = _system->CreatePM(cache);
+    bool ready = packageManager->GetArchives(&fetcher, cache.GetSourceList(), &records) &&
+                 !_error->PendingError();
+    delete packageManager;
+
+    if (!ready)
+        return;
+
+    // Untrusted archives are downloaded only once the user has agreed
+    for (auto it = fetcher.ItemsBegin(); it < fetcher.ItemsEnd(); ++it) {
+        if (!(*it)->IsTrusted())
+            return;
+    }
+
+    struct statvfs buf;
+    const std::string archivesDir = _config->FindDir("Dir::Cache::Archives");
+    if (statvfs(archivesDir.c_str(), &buf) != 0)
+        return;
+
+    const double needed = fetcher.FetchNeeded() - fetcher.PartialPresent();
+    const double available = double(buf.f_bavail) * buf.f_bsize;
+    if (needed + PREFETCH_SPACE_RESERVE > available) {
+        qDebug() << "Not prefetching" << tid << "for lack of disk space";
+        return;
+    }
+
+    fetcher.Run();
+}
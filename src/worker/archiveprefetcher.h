@@ -0,0 +1,99 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef ARCHIVEPREFETCHER_H
+#define ARCHIVEPREFETCHER_H
+
+// Qt includes
+#include <QMutex>
+#include <QObject>
+#include <QVariantMap>
+
+class AptLock;
+
+/**
+ * Downloads the archives of a queued transaction into the archive cache
+ * ahead of time, so that the network is busy while other transactions are
+ * installing. When the transaction runs, it finds its archives in the cache,
+ * or resumes the partial downloads.
+ *
+ * Only transactions without a proxy are prefetched. Nothing is downloaded
+ * if it would leave less than PREFETCH_SPACE_RESERVE bytes free in the
+ * archive cache, if an archive is untrusted, or if the archive cache is
+ * locked by another process. Bandwidth limits such as
+ * Acquire::http::Dl-Limit apply as they do for every download, and so
+ * does the download limit of the transaction.
+ *
+ * The prefetcher uses its own package cache, and should live in a thread
+ * of its own.
+ */
+class ArchivePrefetcher : public QObject
+{
+    Q_OBJECT
+
+    friend class PrefetchAcquire;
+public:
+    explicit ArchivePrefetcher(QObject *parent = nullptr);
+    ~ArchivePrefetcher();
+
+    /**
+     * Stops prefetching for the transaction @p tid, or keeps it from
+     * starting if the prefetch is still pending. Can be called from any
+     * thread.
+     */
+    void cancel(const QString &tid);
+
+    /**
+     * Sets the download limit in bytes per second for prefetching the
+     * archives of the transaction @p tid, 0 if unlimited. Can be called from
+     * any thread, before or during the prefetch.
+     */
+    void setDownloadLimit(const QString &tid, quint64 limit);
+
+public Q_SLOTS:
+    /**
+     * Downloads the archives that the transaction @p tid, which has the
+     * given @p role and @p packages, would download itself. This blocks
+     * until the downloads are done or cancelled.
+     */
+    void prefetch(const QString &tid, int role, const QVariantMap &packages,
+                  bool safeUpgrade);
+
+Q_SIGNALS:
+    /**
+     * Emitted when a prefetch is over. A @p cancelled prefetch may be
+     * tried again later, other prefetches are not worth repeating.
+     */
+    void finished(const QString &tid, bool cancelled);
+
+private:
+    AptLock *m_lock;
+    QMutex m_cancelMutex;
+    QString m_cancelledTid;
+    QString m_limitTid;
+    quint64 m_downloadLimit;
+
+    bool isCancelled(const QString &tid);
+    quint64 downloadLimit(const QString &tid);
+    void fetchArchives(const QString &tid, int role, const QVariantMap &packages,
+                       bool safeUpgrade);
+};
+
+#endif // ARCHIVEPREFETCHER_H
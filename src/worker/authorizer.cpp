@@ -0,0 +1,186 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "authorizer.h"
+
+#include <QCoreApplication>
+#include <QDBusArgument>
+#include <QDBusPendingCallWatcher>
+#include <QDebug>
+#include <QStringBuilder>
+
+#include <limits>
+
+// polkit keeps auth_admin_keep and auth_self_keep results for five minutes
+#define RETAIN_TIMEOUT 300000
+#define POLKIT_ALLOW_USER_INTERACTION 0x1
+
+static QString retainKey(const QString &action, const QString &service)
+{
+    return service % QLatin1Char('\n') % action;
+}
+
+AuthorizationRequest::AuthorizationRequest(const QString &action, const QString &service,
+                                           QObject *parent)
+    : QObject(parent)
+    , m_action(action)
+    , m_service(service)
+{
+}
+
+QString AuthorizationRequest::action() const
+{
+    return m_action;
+}
+
+QString AuthorizationRequest::service() const
+{
+    return m_service;
+}
+
+void AuthorizationRequest::setCaller(const QDBusConnection &connection, const QDBusMessage &message)
+{
+    m_connectionName = connection.name();
+    m_message = message;
+}
+
+QDBusMessage AuthorizationRequest::message() const
+{
+    return m_message;
+}
+
+void AuthorizationRequest::sendReply(const QVariant &value)
+{
+    QList<QVariant> arguments;
+    if (value.isValid())
+        arguments << value;
+
+    QDBusConnection(m_connectionName).send(m_message.createReply(arguments));
+}
+
+void AuthorizationRequest::sendErrorReply(QDBusError::ErrorType type)
+{
+    QDBusConnection(m_connectionName).send(m_message.createErrorReply(type, QString()));
+}
+
+void AuthorizationRequest::finish(bool authorized)
+{
+    emit finished(authorized);
+    deleteLater();
+}
+
+Authorizer::Authorizer(QObject *parent)
+    : QObject(parent)
+{
+    m_clock.start();
+}
+
+Authorizer *Authorizer::instance()
+{
+    static Authorizer *authorizer = new Authorizer(QCoreApplication::instance());
+
+    return authorizer;
+}
+
+AuthorizationRequest *Authorizer::authorize(const QString &action, const QString &service)
+{
+    AuthorizationRequest *request = new AuthorizationRequest(action, service, this);
+
+    if (action.isEmpty() || isRetained(retainKey(action, service))) {
+        // Give the caller a chance to connect to finished()
+        QMetaObject::invokeMethod(request, "finish", Qt::QueuedConnection, Q_ARG(bool, true));
+        return request;
+    }
+
+    QDBusMessage call = QDBusMessage::createMethodCall(QLatin1String("org.freedesktop.PolicyKit1"),
+                                                       QLatin1String("/org/freedesktop/PolicyKit1/Authority"),
+                                                       QLatin1String("org.freedesktop.PolicyKit1.Authority"),
+                                                       QLatin1String("CheckAuthorization"));
+
+    QVariantMap subjectDetails;
+    subjectDetails.insert(QLatin1String("name"), service);
+
+    QDBusArgument subject;
+    subject.beginStructure();
+    subject << QStringLiteral("system-bus-name") << subjectDetails;
+    subject.endStructure();
+
+    QDBusArgument details;
+    details.beginMap(QMetaType::fromType<QString>(), QMetaType::fromType<QString>());
+    details.endMap();
+
+    call << QVariant::fromValue(subject)
+         << action
+         << QVariant::fromValue(details)
+         << quint32(POLKIT_ALLOW_USER_INTERACTION)
+         << QString();
+
+    // Users may take their time to type in a password
+    QDBusPendingCall pending = QDBusConnection::systemBus().asyncCall(call, std::numeric_limits<int>::max());
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pending, this);
+    m_checks.insert(watcher, request);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(checkFinished(QDBusPendingCallWatcher*)));
+
+    return request;
+}
+
+bool Authorizer::isRetained(const QString &key)
+{
+    qint64 now = m_clock.elapsed();
+
+    for (auto iter = m_retained.begin(); iter != m_retained.end();) {
+        if (iter.value() <= now)
+            iter = m_retained.erase(iter);
+        else
+            ++iter;
+    }
+
+    return m_retained.contains(key);
+}
+
+void Authorizer::checkFinished(QDBusPendingCallWatcher *watcher)
+{
+    AuthorizationRequest *request = m_checks.take(watcher);
+    watcher->deleteLater();
+
+    bool authorized = false;
+
+    if (watcher->isError()) {
+        qWarning() << "Authorization check failed" << watcher->error().message();
+    } else {
+        const QDBusArgument result = watcher->reply().arguments().constFirst().value<QDBusArgument>();
+        bool challenge = false;
+        QMap<QString, QString> details;
+
+        result.beginStructure();
+        result >> authorized >> challenge >> details;
+        result.endStructure();
+
+        // Asking polkit again would succeed without a dialog until the
+        // authorization expires, so save it the round trip
+        if (authorized && details.value(QLatin1String("polkit.retains_authorization_after_challenge")) == QLatin1String("1")) {
+            m_retained.insert(retainKey(request->action(), request->service()),
+                              m_clock.elapsed() + RETAIN_TIMEOUT);
+        }
+    }
+
+    request->finish(authorized);
+}
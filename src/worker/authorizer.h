@@ -0,0 +1,105 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef AUTHORIZER_H
+#define AUTHORIZER_H
+
+#include <QDBusConnection>
+#include <QDBusError>
+#include <QDBusMessage>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+
+class QDBusPendingCallWatcher;
+
+/**
+ * A pending polkit authorization check, created by Authorizer::authorize().
+ *
+ * The request emits finished() exactly once and deletes itself afterwards.
+ * It can carry the D-Bus call that is waiting for the result, so that the
+ * delayed reply can be sent once the check is done.
+ */
+class AuthorizationRequest : public QObject
+{
+    Q_OBJECT
+public:
+    QString action() const;
+    QString service() const;
+
+    /**
+     * Remembers the D-Bus call @p message, received on @p connection, that
+     * waits for this request. The caller must have set a delayed reply.
+     */
+    void setCaller(const QDBusConnection &connection, const QDBusMessage &message);
+    QDBusMessage message() const;
+    void sendReply(const QVariant &value = QVariant());
+    void sendErrorReply(QDBusError::ErrorType type);
+
+private:
+    friend class Authorizer;
+    AuthorizationRequest(const QString &action, const QString &service, QObject *parent);
+
+    QString m_action;
+    QString m_service;
+    QString m_connectionName;
+    QDBusMessage m_message;
+
+Q_SIGNALS:
+    void finished(bool authorized);
+
+private Q_SLOTS:
+    void finish(bool authorized);
+};
+
+/**
+ * Checks polkit authorizations without blocking the worker's event loop, so
+ * that other clients are still served while a user is being asked for a
+ * password.
+ */
+class Authorizer : public QObject
+{
+    Q_OBJECT
+public:
+    static Authorizer *instance();
+
+    /**
+     * Starts checking whether the D-Bus client @p service may perform
+     * @p action, allowing polkit to interact with the user. An empty
+     * @p action is always authorized.
+     */
+    AuthorizationRequest *authorize(const QString &action, const QString &service);
+
+private:
+    explicit Authorizer(QObject *parent);
+
+    QHash<QDBusPendingCallWatcher *, AuthorizationRequest *> m_checks;
+    // Expiry times of authorizations that polkit retains, keyed by
+    // service and action
+    QHash<QString, qint64> m_retained;
+    QElapsedTimer m_clock;
+
+    bool isRetained(const QString &key);
+
+private Q_SLOTS:
+    void checkFinished(QDBusPendingCallWatcher *watcher);
+};
+
+#endif // AUTHORIZER_H
@@ -0,0 +1,163 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "bandwidthlimiter.h"
+
+// Apt-pkg includes
+#include <apt-pkg/acquire.h>
+#include <apt-pkg/acquire-item.h>
+#include <apt-pkg/acquire-worker.h>
+
+// System includes
+#include <signal.h>
+
+static bool usesNetwork(pkgAcquire::Worker *worker)
+{
+    if (!worker->Config)
+        return false;
+
+    // Methods that only work on local files or run helpers
+    static const char *const localMethods[] = {
+        "file", "copy", "store", "gpgv", "rred", "cdrom"
+    };
+
+    for (const char *method : localMethods) {
+        if (worker->Config->Access == method)
+            return false;
+    }
+
+    return true;
+}
+
+BandwidthLimiter::BandwidthLimiter()
+    : m_owner(nullptr)
+    , m_budget(0)
+{
+}
+
+BandwidthLimiter::~BandwidthLimiter()
+{
+    resume();
+}
+
+unsigned long long BandwidthLimiter::transferred(pkgAcquire *owner)
+{
+    const bool baseline = (owner != m_owner);
+    unsigned long long transferred = 0;
+    QHash<const void *, unsigned long long> positions;
+
+    if (baseline) {
+        m_owner = owner;
+        m_positions.clear();
+        m_counted.clear();
+    }
+
+    for (pkgAcquire::Worker *worker = owner->WorkersBegin(); worker != 0;
+         worker = owner->WorkerStep(worker)) {
+        if (!worker->CurrentItem)
+            continue;
+
+#if APT_PKG_ABI >= 590
+        const unsigned long long current = worker->CurrentItem->CurrentSize;
+        const unsigned long long resumePoint = worker->CurrentItem->ResumePoint;
+#else
+        const unsigned long long current = worker->CurrentSize;
+        const unsigned long long resumePoint = worker->ResumePoint;
+#endif
+        const void *item = worker->CurrentItem->Owner;
+        const unsigned long long last = baseline ? current
+                                                 : m_positions.value(item, resumePoint);
+
+        if (current > last)
+            transferred += current - last;
+        positions.insert(item, qMax(current, last));
+    }
+
+    // Items that finished since the last pulse. Those that were found on
+    // disk, or were complete before, didn't use the network
+    for (auto it = owner->ItemsBegin(); it != owner->ItemsEnd(); ++it) {
+        const pkgAcquire::Item *item = *it;
+
+        if (!item->Complete || m_counted.contains(item))
+            continue;
+
+        m_counted.insert(item);
+
+        if (baseline || item->Local)
+            continue;
+
+        const unsigned long long last = m_positions.value(item, item->PartialSize);
+        if (item->FileSize > last)
+            transferred += item->FileSize - last;
+        positions.remove(item);
+    }
+
+    m_positions = positions;
+
+    return transferred;
+}
+
+void BandwidthLimiter::pulse(pkgAcquire *owner, quint64 limit)
+{
+    qint64 elapsed = 0;
+    if (m_timer.isValid())
+        elapsed = m_timer.restart();
+    else
+        m_timer.start();
+
+    const unsigned long long bytes = transferred(owner);
+
+    if (limit == 0) {
+        m_budget = 0;
+        resume();
+        return;
+    }
+
+    // Refill for the time since the last pulse, up to one second worth.
+    // The debt is bounded as well, so that a burst, such as the one left
+    // when the limit is lowered, stalls the methods for a second at most
+    m_budget = qMin<qint64>(m_budget + qint64(limit * elapsed / 1000), qint64(limit));
+    m_budget = qMax<qint64>(m_budget - qint64(bytes), -qint64(limit));
+
+    if (m_budget >= 0) {
+        resume();
+        return;
+    }
+
+    if (!m_stopped.isEmpty())
+        return;
+
+    for (pkgAcquire::Worker *worker = owner->WorkersBegin(); worker != 0;
+         worker = owner->WorkerStep(worker)) {
+        if (worker->Process <= 0 || !worker->CurrentItem || !usesNetwork(worker))
+            continue;
+
+        if (kill(worker->Process, SIGSTOP) == 0)
+            m_stopped.append(worker->Process);
+    }
+}
+
+void BandwidthLimiter::resume()
+{
+    for (pid_t pid : m_stopped)
+        kill(pid, SIGCONT);
+
+    m_stopped.clear();
+}
@@ -0,0 +1,85 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef BANDWIDTHLIMITER_H
+#define BANDWIDTHLIMITER_H
+
+// Qt includes
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QSet>
+
+// System includes
+#include <sys/types.h>
+
+class pkgAcquire;
+
+/**
+ * Keeps the downloads of a pkgAcquire below a rate that may change at any
+ * time. The download methods run in processes of their own and read their
+ * limits once when they start, so the rate is enforced from the outside:
+ * the methods that use the network are stopped while the downloads are
+ * ahead of the limit, and continued once they have caught up. TCP flow
+ * control slows down the stalled connections meanwhile.
+ *
+ * The rate is checked on every pulse of the fetcher, so it evens out over a
+ * few pulses. Downloads may burst by up to one second worth of data.
+ *
+ * Only bytes that come over the network count. Archives found in the cache
+ * and the parts of partial files that downloads resume from are free.
+ */
+class BandwidthLimiter
+{
+public:
+    BandwidthLimiter();
+    ~BandwidthLimiter();
+
+    /**
+     * Called on every pulse of @p owner. A @p limit of 0 lets the downloads
+     * run at full speed.
+     */
+    void pulse(pkgAcquire *owner, quint64 limit);
+
+    /**
+     * Continues the stopped methods. Call this before the fetcher shuts
+     * its methods down, since stopped processes don't exit.
+     */
+    void resume();
+
+private:
+    pkgAcquire *m_owner;
+    QElapsedTimer m_timer;
+    // Bytes that may still be downloaded, negative while ahead of the limit
+    qint64 m_budget;
+    QList<pid_t> m_stopped;
+    // How far the items being fetched had got on the last pulse
+    QHash<const void *, unsigned long long> m_positions;
+    // Complete items, whose bytes have been counted
+    QSet<const void *> m_counted;
+
+    /**
+     * Returns the number of bytes downloaded since the last pulse. The first
+     * pulse of a fetcher only takes note of how far its items are.
+     */
+    unsigned long long transferred(pkgAcquire *owner);
+};
+
+#endif // BANDWIDTHLIMITER_H
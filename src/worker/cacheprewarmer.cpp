@@ -0,0 +1,139 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "cacheprewarmer.h"
+
+// Qt includes
+#include <QDebug>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QThread>
+#include <QTimer>
+
+// Apt-pkg includes
+#include <apt-pkg/cachefile.h>
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/error.h>
+
+// System includes
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Own includes
+#include "transactionqueue.h"
+
+#define PREWARM_DELAY 10000 // 10 seconds, for apt and dpkg to finish
+
+// From linux/ioprio.h, which isn't available everywhere
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+
+CachePrewarmer::CachePrewarmer(TransactionQueue *queue, QObject *parent)
+    : QObject(parent)
+    , m_queue(queue)
+    , m_thread(nullptr)
+{
+    // dpkg and apt replace their files by renaming, so watch the directories
+    QFileInfo status(QString::fromStdString(_config->FindFile("Dir::State::status")));
+
+    m_watcher = new QFileSystemWatcher(this);
+    m_watcher->addPath(QString::fromStdString(_config->FindDir("Dir::State::lists")));
+    m_watcher->addPath(status.absolutePath());
+    connect(m_watcher, SIGNAL(directoryChanged(QString)), this, SLOT(schedule()));
+
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setInterval(PREWARM_DELAY);
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(prewarm()));
+
+    // The caches may have gone stale while no worker was running
+    schedule();
+}
+
+CachePrewarmer::~CachePrewarmer()
+{
+    if (m_thread)
+        m_thread->wait();
+}
+
+void CachePrewarmer::schedule()
+{
+    // Restarting the timer folds a burst of changes into one rebuild
+    m_timer->start();
+}
+
+void CachePrewarmer::prewarm()
+{
+    // Transactions bring the caches up to date themselves. Those queued
+    // during the rebuild wait for it, since they may change the APT
+    // configuration it reads
+    if (m_thread || !m_queue->pause()) {
+        schedule();
+        return;
+    }
+
+    m_thread = QThread::create(&CachePrewarmer::buildCaches);
+    connect(m_thread, SIGNAL(finished()), this, SLOT(onBuildFinished()));
+    m_thread->start(QThread::IdlePriority);
+}
+
+void CachePrewarmer::onBuildFinished()
+{
+    m_thread->deleteLater();
+    m_thread = nullptr;
+    m_queue->resume();
+}
+
+void CachePrewarmer::buildCaches()
+{
+    // Leave the disk to everything else. This only affects this thread
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+
+    // Rebuilds the caches if anything they are built from has changed, the
+    // same way opening the cache for a transaction would
+    pkgCacheFile cache;
+    if (!cache.BuildCaches(nullptr, false)) {
+        std::string message;
+        if (_error->PopMessage(message))
+            qWarning() << "Couldn't build the package cache:" << QString::fromStdString(message);
+
+        _error->Discard();
+        return;
+    }
+
+    const std::string paths[] = {
+        _config->FindFile("Dir::Cache::pkgcache"),
+        _config->FindFile("Dir::Cache::srcpkgcache")
+    };
+
+    for (const std::string &path : paths) {
+        if (path.empty())
+            continue;
+
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+}
@@ -0,0 +1,65 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef CACHEPREWARMER_H
+#define CACHEPREWARMER_H
+
+// Qt includes
+#include <QObject>
+
+class QFileSystemWatcher;
+class QThread;
+class QTimer;
+
+class TransactionQueue;
+
+/**
+ * Keeps the binary package caches (pkgcache.bin and srcpkgcache.bin) of a
+ * resident worker current, so that the next transaction doesn't have to
+ * rebuild them after the package lists or the dpkg status have changed.
+ *
+ * The package lists and the directory of the dpkg status file are watched
+ * for changes. Once they have settled for PREWARM_DELAY milliseconds and
+ * no transaction is queued, the caches are rebuilt in a thread of idle CPU
+ * and I/O priority, and read ahead into the page cache. The queue is paused
+ * meanwhile, see TransactionQueue::pause().
+ */
+class CachePrewarmer : public QObject
+{
+    Q_OBJECT
+public:
+    CachePrewarmer(TransactionQueue *queue, QObject *parent);
+    ~CachePrewarmer();
+
+private:
+    TransactionQueue *m_queue;
+    QFileSystemWatcher *m_watcher;
+    QTimer *m_timer;
+    QThread *m_thread;
+
+    static void buildCaches();
+
+private Q_SLOTS:
+    void schedule();
+    void prewarm();
+    void onBuildFinished();
+};
+
+#endif // CACHEPREWARMER_H
@@ -27,10 +27,29 @@
     <property name="filePath" type="s" access="read"/>
     <property name="errorDetails" type="s" access="read"/>
     <property name="frontendCaps" type="i" access="read"/>
+    <property name="lockHolderPid" type="i" access="read"/>
+    <property name="lockHolderCommand" type="s" access="read"/>
+    <property name="terminalOutputSize" type="t" access="read"/>
+    <property name="updateInterval" type="i" access="read"/>
+    <property name="downloadItems" type="a(sistts)" access="read">
+      <annotation name="org.qtproject.QtDBus.QtTypeName" value="QApt::DownloadProgressList"/>
+    </property>
+    <property name="priority" type="i" access="read"/>
+    <property name="streamingInstall" type="b" access="read"/>
+    <property name="coalescable" type="b" access="read"/>
+    <property name="queueMode" type="s" access="read"/>
+    <property name="maxParallelDownloads" type="i" access="read"/>
+    <property name="pipelineDepth" type="i" access="read"/>
+    <property name="downloadRetries" type="i" access="read"/>
+    <property name="downloadLimit" type="t" access="read"/>
     <signal name="propertyChanged">
       <arg name="role" type="i" direction="out"/>
       <arg name="newValue" type="v" direction="out"/>
     </signal>
+    <signal name="propertiesChanged">
+      <arg name="changes" type="a{sv}" direction="out"/>
+      <annotation name="org.qtproject.QtDBus.QtTypeName.Out0" value="QVariantMap"/>
+    </signal>
     <signal name="finished">
       <arg name="exitStatus" type="i" direction="out"/>
     </signal>
@@ -66,5 +85,14 @@
     <method name="setFrontendCaps">
         <arg name="caps" type="i" direction="in"/>
     </method>
+    <method name="requestPeerConnection">
+      <arg name="address" type="s" direction="out"/>
+      <arg name="token" type="s" direction="out"/>
+    </method>
+    <method name="terminalOutput">
+      <arg name="offset" type="t" direction="in"/>
+      <arg name="data" type="ay" direction="out"/>
+      <arg name="start" type="t" direction="out"/>
+    </method>
   </interface>
 </node>
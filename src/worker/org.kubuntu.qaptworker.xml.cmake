@@ -26,6 +26,18 @@
       <arg name="packageNames" type="as" direction="in"/>
       <arg name="dest" type="s" direction="in"/>
     </method>
+    <method name="startTransaction">
+      <arg type="a{sv}" direction="out"/>
+      <annotation name="org.qtproject.QtDBus.QtTypeName.Out0" value="QVariantMap"/>
+      <arg name="role" type="i" direction="in"/>
+      <arg name="instructionsList" type="a{sv}" direction="in"/>
+      <annotation name="org.qtproject.QtDBus.QtTypeName.In1" value="QVariantMap"/>
+      <arg name="properties" type="a{sv}" direction="in"/>
+      <annotation name="org.qtproject.QtDBus.QtTypeName.In2" value="QVariantMap"/>
+    </method>
+    <method name="rebuildCache">
+      <arg type="b" direction="out"/>
+    </method>
     <method name="writeFileToDisk">
       <arg type="b" direction="out"/>
       <arg name="contents" type="s" direction="in"/>
@@ -0,0 +1,134 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "peerserver.h"
+
+#include <QDBusServer>
+#include <QDebug>
+#include <QTimer>
+#include <QUuid>
+
+#include "transaction.hpp"
+
+#define ATTACH_TIMEOUT 5000 // 5 seconds
+#define MAX_PENDING_PEERS 32
+
+PeerServer::PeerServer(QObject *parent)
+    : QObject(parent)
+    , m_server(nullptr)
+    , m_expiryTimer(new QTimer(this))
+{
+    m_clock.start();
+    m_expiryTimer->setInterval(1000);
+    connect(m_expiryTimer, SIGNAL(timeout()), this, SLOT(dropExpiredPeers()));
+}
+
+QString PeerServer::listen()
+{
+    if (!m_server) {
+        m_server = new QDBusServer(QLatin1String("unix:tmpdir=/tmp"), this);
+
+        // Peers are authenticated by their token instead
+        m_server->setAnonymousAuthenticationAllowed(true);
+        connect(m_server, SIGNAL(newConnection(QDBusConnection)),
+                this, SLOT(newConnection(QDBusConnection)));
+    }
+
+    if (!m_server->isConnected()) {
+        qWarning() << "Unable to start peer server" << m_server->lastError().message();
+        return QString();
+    }
+
+    return m_server->address();
+}
+
+QString PeerServer::createToken(Transaction *trans)
+{
+    for (auto iter = m_tokens.begin(); iter != m_tokens.end();) {
+        if (!iter.value() || iter.value() == trans)
+            iter = m_tokens.erase(iter);
+        else
+            ++iter;
+    }
+
+    const QString token = QUuid::createUuid().toString(QUuid::Id128);
+    m_tokens.insert(token, trans);
+
+    return token;
+}
+
+bool PeerServer::attach(const QString &token)
+{
+    const QString name = connection().name();
+
+    // Each connection gets a single try
+    if (!m_pending.remove(name)) {
+        sendErrorReply(QDBusError::AccessDenied);
+        return false;
+    }
+
+    QPointer<Transaction> trans = m_tokens.take(token);
+    if (!trans || !trans->attachPeer(connection())) {
+        sendErrorReply(QDBusError::AccessDenied);
+        // Once the error reply has been sent
+        QMetaObject::invokeMethod(this, "dropPeer", Qt::QueuedConnection,
+                                  Q_ARG(QString, name));
+        return false;
+    }
+
+    return true;
+}
+
+void PeerServer::newConnection(const QDBusConnection &connection)
+{
+    if (m_pending.size() >= MAX_PENDING_PEERS) {
+        QDBusConnection::disconnectFromPeer(connection.name());
+        return;
+    }
+
+    // Until attach() succeeds, all a peer can do is call attach()
+    QDBusConnection peer(connection);
+    peer.registerObject(QLatin1String("/"), this, QDBusConnection::ExportScriptableSlots);
+
+    m_pending.insert(connection.name(), m_clock.elapsed() + ATTACH_TIMEOUT);
+    m_expiryTimer->start();
+}
+
+void PeerServer::dropExpiredPeers()
+{
+    const qint64 now = m_clock.elapsed();
+
+    for (auto iter = m_pending.begin(); iter != m_pending.end();) {
+        if (iter.value() <= now) {
+            QDBusConnection::disconnectFromPeer(iter.key());
+            iter = m_pending.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    if (m_pending.isEmpty())
+        m_expiryTimer->stop();
+}
+
+void PeerServer::dropPeer(const QString &name)
+{
+    QDBusConnection::disconnectFromPeer(name);
+}
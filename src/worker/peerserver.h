@@ -0,0 +1,89 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef PEERSERVER_H
+#define PEERSERVER_H
+
+#include <QDBusConnection>
+#include <QDBusContext>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+
+class QDBusServer;
+class QTimer;
+
+class Transaction;
+
+/**
+ * Offers private peer-to-peer D-Bus connections to transaction owners, so
+ * that the traffic of a transaction doesn't have to pass through the system
+ * bus daemon.
+ *
+ * The owner asks the transaction for a connection over the system bus and
+ * gets the server address and a single-use token. After connecting, the
+ * token is passed to attach(), which moves the transaction over to the new
+ * connection. Connections are accepted anonymously, the token is what
+ * authenticates the peer.
+ *
+ * Since any local user can connect, connections that haven't attached
+ * within ATTACH_TIMEOUT milliseconds, or whose attach() failed, are
+ * dropped, and no more than MAX_PENDING_PEERS of them are kept at a time.
+ */
+class PeerServer : public QObject, protected QDBusContext
+{
+    Q_OBJECT
+
+    Q_CLASSINFO("D-Bus Interface", "org.kubuntu.qaptworker.peer")
+public:
+    explicit PeerServer(QObject *parent = nullptr);
+
+    /**
+     * Starts listening if that hasn't happened yet.
+     *
+     * @return the address peers connect to, or an empty string on failure
+     */
+    QString listen();
+
+    /**
+     * Returns a new single-use token for attaching to @p trans. Older tokens
+     * for @p trans are revoked.
+     */
+    QString createToken(Transaction *trans);
+
+private:
+    QDBusServer *m_server;
+    QHash<QString, QPointer<Transaction> > m_tokens;
+    // Connections that haven't attached yet, by name, with their deadline
+    QHash<QString, qint64> m_pending;
+    QElapsedTimer m_clock;
+    QTimer *m_expiryTimer;
+
+public Q_SLOTS:
+    Q_SCRIPTABLE bool attach(const QString &token);
+
+private Q_SLOTS:
+    void newConnection(const QDBusConnection &connection);
+    void dropExpiredPeers();
+    void dropPeer(const QString &name);
+};
+
+#endif // PEERSERVER_H
@@ -0,0 +1,461 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "streaminginstall.h"
+
+// Qt includes
+#include <QHash>
+
+// Apt-pkg includes
+#include <apt-pkg/acquire.h>
+#include <apt-pkg/acquire-item.h>
+#include <apt-pkg/cachefile.h>
+#include <apt-pkg/error.h>
+#include <apt-pkg/pkgrecords.h>
+#include <apt-pkg/pkgsystem.h>
+
+#include <algorithm>
+#include <numeric>
+
+// Own includes
+#include "transaction.hpp"
+#include "workeracquire.h"
+
+// Every dpkg run ends with processing triggers, so don't run it too often
+#define STREAMING_MAX_BATCHES 8
+#define STREAMING_MIN_BATCH_SIZE (32ULL * 1024 * 1024)
+
+StreamingInstall::StreamingInstall(Transaction *trans, pkgCacheFile *cache, pkgRecords *records)
+    : m_trans(trans)
+    , m_cache(cache)
+    , m_records(records)
+    , m_nextBatch(0)
+    , m_installing(false)
+    , m_failed(false)
+    , m_installProgress(50, 90)
+    , m_installCache(nullptr)
+    , m_installRecords(nullptr)
+    , m_installFetcher(nullptr)
+    , m_installManager(nullptr)
+{
+    m_installProgress.setTransaction(m_trans);
+}
+
+StreamingInstall::~StreamingInstall()
+{
+    clearInstallState();
+    qDeleteAll(m_fetchManagers);
+}
+
+bool StreamingInstall::plan()
+{
+    pkgDepCache *depCache = *m_cache;
+    pkgCache &cache = depCache->GetCache();
+
+    QVector<pkgCache::PkgIterator> changed;
+    QHash<quint32, int> changedIndex;
+
+    for (pkgCache::PkgIterator pkg = depCache->PkgBegin(); !pkg.end(); ++pkg) {
+        const pkgDepCache::StateCache &state = (*depCache)[pkg];
+
+        if (state.Mode == pkgDepCache::ModeKeep && !(state.iFlags & pkgDepCache::ReInstall))
+            continue;
+
+        changedIndex.insert(pkg->ID, changed.size());
+        changed.append(pkg);
+    }
+
+    if (changed.size() < 2)
+        return false;
+
+    // Union-find over the changed packages
+    QVector<int> parent(changed.size());
+    std::iota(parent.begin(), parent.end(), 0);
+
+    auto find = [&parent](int i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+
+    auto unite = [&find, &parent](int first, int second) {
+        first = find(first);
+        second = find(second);
+        if (first != second)
+            parent[second] = first;
+    };
+
+    // Ties package @p i to every changed package a relation of @p ver names
+    auto uniteTargets = [&](int i, const pkgCache::VerIterator &ver) {
+        for (pkgCache::DepIterator dep = ver.DependsList(); !dep.end(); ++dep) {
+            if (!dep.IsCritical() && dep->Type != pkgCache::Dep::Replaces)
+                continue;
+
+            pkgCache::Version **targets = dep.AllTargets();
+            for (pkgCache::Version **target = targets; *target; ++target) {
+                pkgCache::VerIterator targetVer(cache, *target);
+                auto iter = changedIndex.constFind(targetVer.ParentPkg()->ID);
+
+                if (iter != changedIndex.constEnd())
+                    unite(i, *iter);
+            }
+            delete[] targets;
+        }
+    };
+
+    // Ties package @p i to what unchanged installed packages that depend on
+    // @p pkg depend on, since an or-group may switch between them
+    auto uniteReverse = [&](int i, const pkgCache::PkgIterator &pkg) {
+        for (pkgCache::DepIterator rdep = pkg.RevDependsList(); !rdep.end(); ++rdep) {
+            pkgCache::PkgIterator user = rdep.ParentPkg();
+
+            if (changedIndex.contains(user->ID) || user.CurrentVer() != rdep.ParentVer())
+                continue;
+
+            uniteTargets(i, user.CurrentVer());
+        }
+    };
+
+    for (int i = 0; i < changed.size(); ++i) {
+        const pkgCache::PkgIterator &pkg = changed.at(i);
+
+        // Multi-arch siblings have to stay at the same version
+        pkgCache::GrpIterator group = pkg.Group();
+        for (pkgCache::PkgIterator other = group.PackageList(); !other.end();
+             other = group.NextPkg(other)) {
+            auto iter = changedIndex.constFind(other->ID);
+            if (iter != changedIndex.constEnd())
+                unite(i, *iter);
+        }
+
+        uniteReverse(i, pkg);
+
+        const pkgCache::VerIterator versions[] = {
+            pkg.CurrentVer(),
+            (*depCache)[pkg].InstVerIter(cache)
+        };
+
+        for (const pkgCache::VerIterator &ver : versions) {
+            if (ver.end())
+                continue;
+
+            uniteTargets(i, ver);
+
+            for (pkgCache::PrvIterator prv = ver.ProvidesList(); !prv.end(); ++prv)
+                uniteReverse(i, prv.ParentPkg());
+        }
+    }
+
+    // Collect the groups with their download sizes
+    QHash<int, int> groupIndex;
+    QVector<Batch> groups;
+    quint64 totalSize = 0;
+
+    for (int i = 0; i < changed.size(); ++i) {
+        const pkgCache::PkgIterator &pkg = changed.at(i);
+        const pkgDepCache::StateCache &state = (*depCache)[pkg];
+        const int root = find(i);
+
+        if (!groupIndex.contains(root)) {
+            groupIndex.insert(root, groups.size());
+            groups.append(Batch{QVector<Change>(), 0, 0, 0});
+        }
+
+        Batch &group = groups[groupIndex.value(root)];
+        Change change;
+        change.name = pkg.Name();
+        change.arch = pkg.Arch();
+        change.purge = (state.iFlags & pkgDepCache::Purge);
+        change.reinstall = (state.iFlags & pkgDepCache::ReInstall);
+        change.automatic = (state.Flags & pkgCache::Flag::Auto);
+
+        if (state.Mode != pkgDepCache::ModeDelete) {
+            pkgCache::VerIterator ver = state.InstVerIter(cache);
+            change.version = ver.VerStr();
+            group.downloadSize += ver->Size;
+            totalSize += ver->Size;
+        }
+
+        group.changes.append(change);
+    }
+
+    // Small groups first, so that dpkg has something to do early
+    std::stable_sort(groups.begin(), groups.end(), [](const Batch &first, const Batch &second) {
+        return first.downloadSize < second.downloadSize;
+    });
+
+    const quint64 batchSize = qMax<quint64>(totalSize / STREAMING_MAX_BATCHES,
+                                            STREAMING_MIN_BATCH_SIZE);
+
+    m_batches.clear();
+    for (const Batch &group : groups) {
+        if (m_batches.isEmpty() || m_batches.last().downloadSize >= batchSize)
+            m_batches.append(Batch{QVector<Change>(), 0, 0, 0});
+
+        m_batches.last().changes += group.changes;
+        m_batches.last().downloadSize += group.downloadSize;
+    }
+
+    if (m_batches.size() < 2)
+        return false;
+
+    // Check that the system is consistent after every batch, and that every
+    // batch can be ordered on its own
+    bool valid = depCache->Init(nullptr);
+    for (int i = 0; valid && i < m_batches.size(); ++i)
+        valid = markChanges(m_cache, m_batches.at(i).changes);
+
+    for (int i = 0; valid && i < m_batches.size(); ++i)
+        valid = depCache->Init(nullptr) && markChanges(m_cache, m_batches.at(i).changes);
+
+    // Back to the full set of changes
+    depCache->Init(nullptr);
+    for (const Batch &batch : m_batches)
+        markChanges(m_cache, batch.changes);
+
+    _error->Discard();
+
+    return valid;
+}
+
+bool StreamingInstall::markChanges(pkgCacheFile *cache, const QVector<Change> &changes)
+{
+    pkgDepCache *depCache = *cache;
+
+    {
+        pkgDepCache::ActionGroup group(*depCache);
+
+        for (const Change &change : changes) {
+            pkgCache::PkgIterator pkg = depCache->FindPkg(change.name, change.arch);
+            if (pkg.end())
+                return false;
+
+            if (change.version.empty()) {
+                depCache->MarkDelete(pkg, change.purge);
+                continue;
+            }
+
+            if (change.reinstall) {
+                depCache->SetReInstall(pkg, true);
+                continue;
+            }
+
+            pkgCache::VerIterator ver = pkg.VersionList();
+            while (!ver.end() && change.version != ver.VerStr())
+                ++ver;
+
+            if (ver.end())
+                return false;
+
+            depCache->SetCandidateVersion(ver);
+            depCache->MarkInstall(pkg, false, 0, !change.automatic);
+            depCache->MarkAuto(pkg, change.automatic);
+
+            if ((*depCache)[pkg].InstallVer != ver)
+                return false;
+        }
+    }
+
+    return depCache->BrokenCount() == 0;
+}
+
+bool StreamingInstall::queueArchives(pkgAcquire *fetcher)
+{
+    pkgDepCache *depCache = *m_cache;
+    bool success = true;
+
+    for (Batch &batch : m_batches) {
+        depCache->Init(nullptr);
+        markChanges(m_cache, batch.changes);
+
+        pkgPackageManager *packageManager = _system->CreatePM(*m_cache);
+        // The fetcher's items write their file names back to the manager
+        m_fetchManagers.append(packageManager);
+
+        batch.firstItem = fetcher->ItemsEnd() - fetcher->ItemsBegin();
+        if (!packageManager->GetArchives(fetcher, m_cache->GetSourceList(), m_records)) {
+            success = false;
+            break;
+        }
+        batch.endItem = fetcher->ItemsEnd() - fetcher->ItemsBegin();
+    }
+
+    depCache->Init(nullptr);
+    for (const Batch &batch : m_batches)
+        markChanges(m_cache, batch.changes);
+
+    return success;
+}
+
+StreamingInstall::BatchState StreamingInstall::batchState(pkgAcquire *fetcher, const Batch &batch,
+                                                          bool fetchDone) const
+{
+    auto items = fetcher->ItemsBegin();
+
+    for (int i = batch.firstItem; i < batch.endItem; ++i) {
+        const pkgAcquire::Item *item = items[i];
+
+        if (item->Status != pkgAcquire::Item::StatDone || !item->Complete)
+            return fetchDone ? BatchFailed : BatchPending;
+    }
+
+    return BatchFetched;
+}
+
+bool StreamingInstall::hasStarted() const
+{
+    return m_nextBatch > 0;
+}
+
+bool StreamingInstall::pulse(pkgAcquire *fetcher, WorkerAcquire *acquire)
+{
+    if (m_failed)
+        return false;
+
+    if (m_installing) {
+        if (m_installProgress.poll(0))
+            return true;
+
+        if (!finishBatch())
+            return false;
+    }
+
+    if (m_nextBatch < m_batches.size() &&
+        batchState(fetcher, m_batches.at(m_nextBatch), false) == BatchFetched) {
+        // The install progress is more telling from now on
+        acquire->setProgressReported(false);
+
+        return startBatch();
+    }
+
+    return true;
+}
+
+bool StreamingInstall::finish(pkgAcquire *fetcher)
+{
+    if (m_installing) {
+        while (m_installProgress.poll(100)) {}
+
+        if (!finishBatch())
+            return false;
+    }
+
+    if (m_failed)
+        return false;
+
+    while (m_nextBatch < m_batches.size()) {
+        // What has been installed stays, the rest is left alone
+        if (batchState(fetcher, m_batches.at(m_nextBatch), true) != BatchFetched) {
+            m_trans->setError(QApt::FetchError);
+            m_failed = true;
+            return false;
+        }
+
+        if (!startBatch())
+            return false;
+
+        while (m_installProgress.poll(100)) {}
+
+        if (!finishBatch())
+            return false;
+    }
+
+    return true;
+}
+
+bool StreamingInstall::startBatch()
+{
+    const Batch &batch = m_batches.at(m_nextBatch);
+
+    // The previous batch changed the system, so start from a fresh cache
+    m_installCache = new pkgCacheFile;
+    bool ready = m_installCache->ReadOnlyOpen(nullptr) &&
+                 markChanges(m_installCache, batch.changes);
+
+    if (ready) {
+        m_installRecords = new pkgRecords(*m_installCache);
+        m_installFetcher = new pkgAcquire;
+        m_installManager = _system->CreatePM(*m_installCache);
+
+        // Only picks up the downloaded archives
+        ready = m_installManager->GetArchives(m_installFetcher, m_installCache->GetSourceList(),
+                                              m_installRecords) && !_error->PendingError();
+
+        for (auto it = m_installFetcher->ItemsBegin(); ready && it < m_installFetcher->ItemsEnd(); ++it)
+            ready = (*it)->Complete;
+    }
+
+    if (ready) {
+        const int count = m_batches.size();
+        m_installProgress.setProgressRange(50 + 40 * m_nextBatch / count,
+                                           50 + 40 * (m_nextBatch + 1) / count);
+        ready = m_installProgress.begin(m_installManager);
+    }
+
+    ++m_nextBatch;
+
+    if (!ready) {
+        std::string message;
+        if (_error->PopMessage(message))
+            m_trans->setErrorDetails(m_trans->errorDetails() + QString::fromStdString(message));
+
+        m_trans->setError(QApt::CommitError);
+        m_failed = true;
+        clearInstallState();
+        return false;
+    }
+
+    // dpkg can't be interrupted
+    m_trans->setCancellable(false);
+    m_installing = true;
+
+    return true;
+}
+
+bool StreamingInstall::finishBatch()
+{
+    m_installing = false;
+    pkgPackageManager::OrderResult result = m_installProgress.finish();
+    clearInstallState();
+
+    if (result != pkgPackageManager::Completed) {
+        // Error details set by WorkerInstallProgress
+        m_trans->setError(QApt::CommitError);
+        m_failed = true;
+        return false;
+    }
+
+    return true;
+}
+
+void StreamingInstall::clearInstallState()
+{
+    delete m_installManager;
+    delete m_installFetcher;
+    delete m_installRecords;
+    delete m_installCache;
+
+    m_installManager = nullptr;
+    m_installFetcher = nullptr;
+    m_installRecords = nullptr;
+    m_installCache = nullptr;
+}
@@ -0,0 +1,159 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef STREAMINGINSTALL_H
+#define STREAMINGINSTALL_H
+
+// Qt includes
+#include <QVector>
+
+// Apt-pkg includes
+#include <apt-pkg/packagemanager.h>
+
+// Own includes
+#include "workerinstallprogress.h"
+
+class pkgAcquire;
+class pkgCacheFile;
+class pkgRecords;
+
+class Transaction;
+class WorkerAcquire;
+
+/**
+ * Installs the changes of a commit in batches while the archives of later
+ * batches are still downloading.
+ *
+ * The changed packages are split into groups that are not tied to each
+ * other by a depends, pre-depends, conflicts, breaks, obsoletes or replaces
+ * relation of either their current or their new version, nor by being the
+ * same package for different architectures. Recommends and suggests are
+ * not followed. A changed package is also tied to the changed targets of
+ * those relations of the unchanged installed packages that depend on it or
+ * on what it provides, since an or-group may switch between them. Whether
+ * each batch leaves the system consistent on its own is checked by marking
+ * it, see plan(). The groups are then put together into a few batches of
+ * about the same download size, smallest first, so that dpkg can start
+ * early.
+ *
+ * The archives of all batches are downloaded by one fetcher, batch after
+ * batch. On every pulse of the fetcher, the next batch is handed to dpkg
+ * once its archives are all there. If a download fails, the batches
+ * installed so far stay installed, and nothing else is installed. If dpkg
+ * fails, the downloads are stopped. Either way, the system is left in a
+ * consistent state.
+ */
+class StreamingInstall
+{
+public:
+    StreamingInstall(Transaction *trans, pkgCacheFile *cache, pkgRecords *records);
+    ~StreamingInstall();
+
+    /**
+     * Splits the changes marked in the cache into batches.
+     *
+     * @return @c false if the changes cannot be split into at least two
+     * batches, in which case there is nothing to gain from streaming
+     */
+    bool plan();
+
+    /**
+     * Queues the archives of every batch in @p fetcher, in batch order.
+     * Each batch is checked to be installable on its own. The marks of the
+     * cache are the full set of changes again afterwards.
+     *
+     * The fetcher must be destroyed before this object.
+     *
+     * @return @c false if a batch cannot be installed on its own
+     */
+    bool queueArchives(pkgAcquire *fetcher);
+
+    /**
+     * Called on every pulse of the fetcher, whose progress is reported by
+     * @p acquire. Starts installing the next batch once its archives are
+     * downloaded. Doesn't wait for the user, a config file prompt is
+     * answered on a later pulse.
+     *
+     * @return @c false if installing failed and the downloads should stop
+     */
+    bool pulse(pkgAcquire *fetcher, WorkerAcquire *acquire);
+
+    /**
+     * Called after the fetcher has finished. Waits for the batch being
+     * installed, then installs the remaining batches if their archives
+     * were downloaded. Sets the error of the transaction on failure.
+     *
+     * @return @c true if every batch has been installed
+     */
+    bool finish(pkgAcquire *fetcher);
+
+    /// Returns @c true once the first batch has been handed to dpkg
+    bool hasStarted() const;
+
+private:
+    struct Change {
+        std::string name;
+        std::string arch;
+        // Empty for removals
+        std::string version;
+        bool purge;
+        bool reinstall;
+        bool automatic;
+    };
+
+    struct Batch {
+        QVector<Change> changes;
+        quint64 downloadSize;
+        // Range of the batch's archives in the fetcher's items
+        int firstItem;
+        int endItem;
+    };
+
+    enum BatchState {
+        BatchPending,
+        BatchFetched,
+        BatchFailed
+    };
+
+    Transaction *m_trans;
+    pkgCacheFile *m_cache;
+    pkgRecords *m_records;
+    QVector<Batch> m_batches;
+    QVector<pkgPackageManager *> m_fetchManagers;
+    int m_nextBatch;
+    bool m_installing;
+    bool m_failed;
+    WorkerInstallProgress m_installProgress;
+
+    // The state of the batch being installed. Each batch is installed
+    // from a fresh cache, since the previous batch changed the system
+    pkgCacheFile *m_installCache;
+    pkgRecords *m_installRecords;
+    pkgAcquire *m_installFetcher;
+    pkgPackageManager *m_installManager;
+
+    static bool markChanges(pkgCacheFile *cache, const QVector<Change> &changes);
+    BatchState batchState(pkgAcquire *fetcher, const Batch &batch, bool fetchDone) const;
+    bool startBatch();
+    bool finishBatch();
+    void clearInstallState();
+};
+
+#endif // STREAMINGINSTALL_H
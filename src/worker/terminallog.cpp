@@ -0,0 +1,79 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "terminallog.h"
+
+#include <cstring>
+
+TerminalLog::TerminalLog(int capacity)
+    : m_buffer(capacity, '\0')
+    , m_size(0)
+{
+}
+
+void TerminalLog::append(const char *data, int size)
+{
+    const int capacity = m_buffer.size();
+
+    // Only the tail of oversized writes would survive anyway
+    if (size > capacity) {
+        m_size += size - capacity;
+        data += size - capacity;
+        size = capacity;
+    }
+
+    const int position = m_size % capacity;
+    const int first = qMin(size, capacity - position);
+
+    char *buffer = m_buffer.data();
+    memcpy(buffer + position, data, first);
+    memcpy(buffer, data + first, size - first);
+
+    m_size += size;
+}
+
+quint64 TerminalLog::size() const
+{
+    return m_size;
+}
+
+quint64 TerminalLog::firstOffset() const
+{
+    const quint64 capacity = m_buffer.size();
+
+    return (m_size > capacity) ? m_size - capacity : 0;
+}
+
+QByteArray TerminalLog::read(quint64 offset, quint64 *start, int maxSize) const
+{
+    offset = qBound(firstOffset(), offset, m_size);
+    if (start)
+        *start = offset;
+
+    const int capacity = m_buffer.size();
+    const int size = qMin<quint64>(m_size - offset, maxSize);
+    const int position = offset % capacity;
+    const int first = qMin(size, capacity - position);
+
+    QByteArray chunk(m_buffer.constData() + position, first);
+    chunk.append(m_buffer.constData(), size - first);
+
+    return chunk;
+}
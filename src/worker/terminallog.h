@@ -0,0 +1,71 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef TERMINALLOG_H
+#define TERMINALLOG_H
+
+#include <QByteArray>
+
+/**
+ * A fixed size ring buffer for the terminal output of a transaction.
+ *
+ * Every byte ever appended has an offset, counted from the start of the
+ * transaction. Once the buffer is full, the oldest output is overwritten,
+ * so readers asking for an offset that has already been dropped get the
+ * oldest output still available instead.
+ *
+ * TerminalLog is not thread-safe; Transaction guards it with its data mutex.
+ */
+class TerminalLog
+{
+public:
+    enum {
+        DefaultCapacity = 256 * 1024,
+        MaxChunkSize = 64 * 1024
+    };
+
+    explicit TerminalLog(int capacity = DefaultCapacity);
+
+    void append(const char *data, int size);
+
+    /**
+     * Returns the offset just after the newest output, i.e. the number of
+     * bytes appended in total.
+     */
+    quint64 size() const;
+
+    /**
+     * Returns the offset of the oldest output still held.
+     */
+    quint64 firstOffset() const;
+
+    /**
+     * Returns up to @p maxSize bytes of output from @p offset on. If @p offset
+     * has already been dropped, reading starts at firstOffset(). The offset
+     * reading actually started at is stored in @p start.
+     */
+    QByteArray read(quint64 offset, quint64 *start, int maxSize = MaxChunkSize) const;
+
+private:
+    QByteArray m_buffer;
+    quint64 m_size;
+};
+
+#endif // TERMINALLOG_H
@@ -22,19 +22,26 @@
 #include "transaction.hpp"
 
 // Qt includes
+#include <QMetaProperty>
 #include <QTimer>
 #include <QUuid>
 #include <QDBusConnection>
 #include <qmutex.h>
 
+#include <algorithm>
+
 // Own includes
-#include "qaptauthorization.h"
+#include "authorizer.h"
+#include "peerserver.h"
 #include "transactionadaptor.h"
 #include "transactionqueue.h"
 #include "worker/urihelper.h"
 
 
 #define IDLE_TIMEOUT 30000 // 30 seconds
+#define DEFAULT_UPDATE_INTERVAL 100 // 10 updates per second
+// Enough to keep the connections of a yielding transaction alive
+#define YIELDING_DOWNLOAD_LIMIT (32 * 1024) // 32 KiB/s
 
 Transaction::Transaction(TransactionQueue *queue, int userId)
     : Transaction(queue, userId, QApt::EmptyRole, QVariantMap())
@@ -45,6 +52,7 @@ Transaction::Transaction(TransactionQueue *queue, int userId,
                          QApt::TransactionRole role, QVariantMap packagesList)
     : QObject(queue)
     , m_queue(queue)
+    , m_peerServer(nullptr)
     , m_uid(userId)
     , m_role(role)
     , m_status(QApt::SetupStatus)
@@ -60,6 +68,20 @@ Transaction::Transaction(TransactionQueue *queue, int userId,
     , m_safeUpgrade(true)
     , m_replaceConfFile(false)
     , m_frontendCaps(QApt::NoCaps)
+    , m_lockHolderPid(0)
+    , m_terminalNotifyPending(false)
+    , m_priority(QApt::NormalPriority)
+    , m_preemptionRequested(false)
+    , m_isPreempted(false)
+    , m_streamingInstall(false)
+    , m_isCoalescable(false)
+    , m_maxParallelDownloads(-1)
+    , m_pipelineDepth(-1)
+    , m_downloadRetries(-1)
+    , m_downloadLimit(0)
+    , m_bandwidthYielding(false)
+    , m_isAuthorizing(false)
+    , m_updateInterval(DEFAULT_UPDATE_INTERVAL)
     , m_dataMutex()
 {
     new TransactionAdaptor(this);
@@ -79,17 +101,34 @@ Transaction::Transaction(TransactionQueue *queue, int userId,
     m_roleActionMap[QApt::CommitChangesRole] = dbusActionUri("commitchanges");
     m_roleActionMap[QApt::DownloadArchivesRole] = QString("");
     m_roleActionMap[QApt::InstallFileRole] = dbusActionUri("commitchanges");
+    m_roleActionMap[QApt::RebuildCacheRole] = QString("");
 
     m_queue->addPending(this);
     m_idleTimer = new QTimer(this);
     m_idleTimer->start(IDLE_TIMEOUT);
     connect(m_idleTimer, SIGNAL(timeout()),
             this, SLOT(emitIdleTimeout()));
+
+    // Tell clients about new terminal output at most 4 times per second
+    m_terminalTimer = new QTimer(this);
+    m_terminalTimer->setSingleShot(true);
+    m_terminalTimer->setInterval(250);
+    connect(m_terminalTimer, SIGNAL(timeout()),
+            this, SLOT(emitTerminalOutputSize()));
+
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(m_updateInterval);
+    connect(m_flushTimer, SIGNAL(timeout()),
+            this, SLOT(flushPropertyChanges()));
 }
 
 Transaction::~Transaction()
 {
     QDBusConnection::systemBus().unregisterObject(m_tid);
+
+    if (!m_peerConnectionName.isEmpty())
+        QDBusConnection(m_peerConnectionName).unregisterObject(m_tid);
 }
 
 QString Transaction::transactionId() const
@@ -121,7 +160,7 @@ void Transaction::setRole(int role)
 
     m_role = (QApt::TransactionRole)role;
 
-    emit propertyChanged(QApt::RoleProperty, QDBusVariant(role));
+    emitPropertyChanged(QApt::RoleProperty, QDBusVariant(role));
 }
 
 int Transaction::status()
@@ -135,7 +174,10 @@ void Transaction::setStatus(QApt::TransactionStatus status)
 {
     QMutexLocker lock(&m_dataMutex);
     m_status = status;
-    emit propertyChanged(QApt::StatusProperty, QDBusVariant((int)status));
+    emitPropertyChanged(QApt::StatusProperty, QDBusVariant((int)status));
+
+    for (Transaction *member : m_coalesced)
+        member->setStatus(status);
 
     if (m_status != QApt::SetupStatus && m_idleTimer) {
         m_idleTimer->stop(); // We are now queued and are no longer idle
@@ -154,8 +196,13 @@ int Transaction::error()
 
 void Transaction::setError(QApt::ErrorCode code)
 {
+    QMutexLocker lock(&m_dataMutex);
+
     m_error = code;
-    emit propertyChanged(QApt::ErrorProperty, QDBusVariant((int)code));
+    emitPropertyChanged(QApt::ErrorProperty, QDBusVariant((int)code));
+
+    for (Transaction *member : m_coalesced)
+        member->setError(code);
 }
 
 QString Transaction::locale()
@@ -175,7 +222,7 @@ void Transaction::setLocale(QString locale)
     }
 
     m_locale = locale;
-    emit propertyChanged(QApt::LocaleProperty, QDBusVariant(locale));
+    emitPropertyChanged(QApt::LocaleProperty, QDBusVariant(locale));
 }
 
 QString Transaction::proxy()
@@ -195,7 +242,7 @@ void Transaction::setProxy(QString proxy)
     }
 
     m_proxy = proxy;
-    emit propertyChanged(QApt::ProxyProperty, QDBusVariant(proxy));
+    emitPropertyChanged(QApt::ProxyProperty, QDBusVariant(proxy));
 }
 
 QString Transaction::debconfPipe()
@@ -222,7 +269,7 @@ void Transaction::setDebconfPipe(QString pipe)
     }
 
     m_debconfPipe = pipe;
-    emit propertyChanged(QApt::DebconfPipeProperty, QDBusVariant(pipe));
+    emitPropertyChanged(QApt::DebconfPipeProperty, QDBusVariant(pipe));
 }
 
 QVariantMap Transaction::packages()
@@ -242,7 +289,7 @@ void Transaction::setPackages(QVariantMap packageList)
     }
 
     m_packages = packageList;
-    emit propertyChanged(QApt::PackagesProperty, QDBusVariant(packageList));
+    emitPropertyChanged(QApt::PackagesProperty, QDBusVariant(packageList));
 }
 
 bool Transaction::isCancellable()
@@ -257,7 +304,10 @@ void Transaction::setCancellable(bool cancellable)
     QMutexLocker lock(&m_dataMutex);
 
     m_isCancellable = cancellable;
-    emit propertyChanged(QApt::CancellableProperty, QDBusVariant(cancellable));
+    emitPropertyChanged(QApt::CancellableProperty, QDBusVariant(cancellable));
+
+    for (Transaction *member : m_coalesced)
+        member->setCancellable(cancellable);
 }
 
 bool Transaction::isCancelled()
@@ -279,7 +329,7 @@ void Transaction::setExitStatus(QApt::ExitStatus exitStatus)
     QMutexLocker lock(&m_dataMutex);
 
     m_exitStatus = exitStatus;
-    emit propertyChanged(QApt::ExitStatusProperty, QDBusVariant(exitStatus));
+    emitPropertyChanged(QApt::ExitStatusProperty, QDBusVariant(exitStatus));
     setStatus(QApt::FinishedStatus);
     emit finished(exitStatus);
 }
@@ -296,7 +346,7 @@ void Transaction::setMediumRequired(const QString &label, const QString &medium)
     QMutexLocker lock(&m_dataMutex);
 
     m_medium = medium;
-    m_isPaused = true;
+    setIsPaused(true);
 
     emit mediumRequired(label, medium);
 }
@@ -305,7 +355,7 @@ void Transaction::setConfFileConflict(const QString &currentPath, const QString
 {
     QMutexLocker lock(&m_dataMutex);
 
-    m_isPaused = true;
+    setIsPaused(true);
     m_currentConfPath = currentPath;
 
     emit configFileConflict(currentPath, newPath);
@@ -313,16 +363,32 @@ void Transaction::setConfFileConflict(const QString &currentPath, const QString
 
 bool Transaction::isPaused()
 {
-    QMutexLocker lock(&m_dataMutex);
+    QMutexLocker lock(&m_pauseMutex);
 
     return m_isPaused;
 }
 
 void Transaction::setIsPaused(bool paused)
 {
-    QMutexLocker lock(&m_dataMutex);
+    QMutexLocker lock(&m_pauseMutex);
+
+    if (m_isPaused == paused)
+        return;
 
     m_isPaused = paused;
+    if (!paused)
+        m_pauseCondition.wakeAll();
+
+    lock.unlock();
+    emitPropertyChanged(QApt::PausedProperty, QDBusVariant(paused));
+}
+
+void Transaction::waitWhilePaused()
+{
+    QMutexLocker lock(&m_pauseMutex);
+
+    while (m_isPaused)
+        m_pauseCondition.wait(&m_pauseMutex);
 }
 
 QString Transaction::statusDetails()
@@ -337,7 +403,10 @@ void Transaction::setStatusDetails(const QString &details)
     QMutexLocker lock(&m_dataMutex);
 
     m_statusDetails = details;
-    emit propertyChanged(QApt::StatusDetailsProperty, QDBusVariant(details));
+    queuePropertyChange(QApt::StatusDetailsProperty, QDBusVariant(details));
+
+    for (Transaction *member : m_coalesced)
+        member->setStatusDetails(details);
 }
 
 int Transaction::progress()
@@ -352,7 +421,10 @@ void Transaction::setProgress(int progress)
     QMutexLocker lock(&m_dataMutex);
 
     m_progress = progress;
-    emit propertyChanged(QApt::ProgressProperty, QDBusVariant(progress));
+    queuePropertyChange(QApt::ProgressProperty, QDBusVariant(progress));
+
+    for (Transaction *member : m_coalesced)
+        member->setProgress(progress);
 }
 
 QString Transaction::service() const
@@ -372,8 +444,39 @@ void Transaction::setDownloadProgress(const QApt::DownloadProgress &downloadProg
     QMutexLocker lock(&m_dataMutex);
 
     m_downloadProgress = downloadProgress;
-    emit propertyChanged(QApt::DownloadProgressProperty,
-                         QDBusVariant(QVariant::fromValue((downloadProgress))));
+    queuePropertyChange(QApt::DownloadProgressProperty,
+                        QDBusVariant(QVariant::fromValue((downloadProgress))));
+
+    for (Transaction *member : m_coalesced)
+        member->setDownloadProgress(downloadProgress);
+}
+
+QApt::DownloadProgressList Transaction::downloadItems()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_downloadItems;
+}
+
+void Transaction::setDownloadItems(const QApt::DownloadProgressList &changedItems)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    for (const QApt::DownloadProgress &item : changedItems) {
+        auto index = m_downloadItemIndex.constFind(item.uri());
+        if (index != m_downloadItemIndex.constEnd()) {
+            m_downloadItems[*index] = item;
+        } else {
+            m_downloadItemIndex.insert(item.uri(), m_downloadItems.size());
+            m_downloadItems.append(item);
+        }
+    }
+
+    queuePropertyChange(QApt::DownloadItemsProperty,
+                        QDBusVariant(QVariant::fromValue(changedItems)));
+
+    for (Transaction *member : m_coalesced)
+        member->setDownloadItems(changedItems);
 }
 
 void Transaction::setService(const QString &service)
@@ -393,10 +496,14 @@ void Transaction::setUntrustedPackages(const QStringList &untrusted, bool prompt
     QMutexLocker lock(&m_dataMutex);
 
     m_untrusted = untrusted;
-    emit propertyChanged(QApt::UntrustedPackagesProperty, QDBusVariant(untrusted));
+    emitPropertyChanged(QApt::UntrustedPackagesProperty, QDBusVariant(untrusted));
+
+    // Only the client of this transaction is asked
+    for (Transaction *member : m_coalesced)
+        member->setUntrustedPackages(untrusted, false);
 
     if (promptUser) {
-        m_isPaused = true;
+        setIsPaused(true);
         emit promptUntrusted(untrusted);
     }
 }
@@ -418,7 +525,10 @@ void Transaction::setDownloadSpeed(quint64 downloadSpeed)
     QMutexLocker lock(&m_dataMutex);
 
     m_downloadSpeed = downloadSpeed;
-    emit propertyChanged(QApt::DownloadSpeedProperty, QDBusVariant(downloadSpeed));
+    queuePropertyChange(QApt::DownloadSpeedProperty, QDBusVariant(downloadSpeed));
+
+    for (Transaction *member : m_coalesced)
+        member->setDownloadSpeed(downloadSpeed);
 }
 
 quint64 Transaction::downloadETA()
@@ -433,7 +543,10 @@ void Transaction::setETA(quint64 ETA)
     QMutexLocker lock(&m_dataMutex);
 
     m_ETA = ETA;
-    emit propertyChanged(QApt::DownloadETAProperty, QDBusVariant(ETA));
+    queuePropertyChange(QApt::DownloadETAProperty, QDBusVariant(ETA));
+
+    for (Transaction *member : m_coalesced)
+        member->setETA(ETA);
 }
 
 QString Transaction::filePath()
@@ -448,7 +561,7 @@ void Transaction::setFilePath(const QString &filePath)
     QMutexLocker lock(&m_dataMutex);
 
     m_filePath = filePath;
-    emit propertyChanged(QApt::FilePathProperty, QDBusVariant(filePath));
+    emitPropertyChanged(QApt::FilePathProperty, QDBusVariant(filePath));
 }
 
 QString Transaction::errorDetails()
@@ -463,7 +576,10 @@ void Transaction::setErrorDetails(const QString &errorDetails)
     QMutexLocker lock(&m_dataMutex);
 
     m_errorDetails = errorDetails;
-    emit propertyChanged(QApt::ErrorDetailsProperty, QDBusVariant(errorDetails));
+    emitPropertyChanged(QApt::ErrorDetailsProperty, QDBusVariant(errorDetails));
+
+    for (Transaction *member : m_coalesced)
+        member->setErrorDetails(errorDetails);
 }
 
 bool Transaction::safeUpgrade() const
@@ -486,16 +602,227 @@ int Transaction::frontendCaps() const
     return m_frontendCaps;
 }
 
+int Transaction::lockHolderPid()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_lockHolderPid;
+}
+
+QString Transaction::lockHolderCommand()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_lockHolderCommand;
+}
+
+quint64 Transaction::terminalOutputSize()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_terminalLog.size();
+}
+
+void Transaction::appendTerminalOutput(const char *data, int size)
+{
+    if (size <= 0)
+        return;
+
+    QMutexLocker lock(&m_dataMutex);
+
+    m_terminalLog.append(data, size);
+
+    // The timer lives in the main thread
+    if (!m_terminalNotifyPending) {
+        m_terminalNotifyPending = true;
+        QMetaObject::invokeMethod(m_terminalTimer, "start", Qt::QueuedConnection);
+    }
+
+    for (Transaction *member : m_coalesced)
+        member->appendTerminalOutput(data, size);
+}
+
+void Transaction::appendTerminalOutput(const QByteArray &data)
+{
+    appendTerminalOutput(data.constData(), data.size());
+}
+
+void Transaction::setLockHolder(int pid, const QString &command)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    m_lockHolderPid = pid;
+    m_lockHolderCommand = command;
+    emitPropertyChanged(QApt::LockHolderPidProperty, QDBusVariant(pid));
+    emitPropertyChanged(QApt::LockHolderCommandProperty, QDBusVariant(command));
+
+    for (Transaction *member : m_coalesced)
+        member->setLockHolder(pid, command);
+}
+
 void Transaction::run()
 {
-    if (isForeignUser() || !authorizeRun()) {
+    if (isForeignUser()) {
         sendErrorReply(QDBusError::AccessDenied);
         return;
     }
 
+    // A transaction only runs once
+    m_dataMutex.lock();
+    const bool canRun = (m_status == QApt::SetupStatus && !m_isAuthorizing);
+    m_dataMutex.unlock();
+
+    if (!canRun) {
+        sendErrorReply(QDBusError::Failed);
+        return;
+    }
+
+    setDelayedReply(true);
+    authorizeRun(connection(), message(), SLOT(runAuthorized(bool)));
+}
+
+void Transaction::start(const QDBusConnection &connection, const QDBusMessage &message)
+{
+    authorizeRun(connection, message, SLOT(startAuthorized(bool)));
+}
+
+void Transaction::runAuthorized(bool authorized)
+{
+    AuthorizationRequest *request = qobject_cast<AuthorizationRequest *>(sender());
+
+    m_dataMutex.lock();
+    m_isAuthorizing = false;
+    m_dataMutex.unlock();
+
+    if (!authorized) {
+        // The owner may try again
+        setStatus(QApt::SetupStatus);
+        request->sendErrorReply(QDBusError::AccessDenied);
+        return;
+    }
+
+    enqueue();
+    request->sendReply();
+}
+
+void Transaction::startAuthorized(bool authorized)
+{
+    AuthorizationRequest *request = qobject_cast<AuthorizationRequest *>(sender());
+
+    m_dataMutex.lock();
+    m_isAuthorizing = false;
+    m_dataMutex.unlock();
+
+    if (!authorized) {
+        request->sendErrorReply(QDBusError::AccessDenied);
+        // Nobody has a handle to retry a transaction started in one call
+        emit idleTimeout(this);
+        return;
+    }
+
+    enqueue();
+    request->sendReply(snapshot());
+}
+
+void Transaction::enqueue()
+{
     QMutexLocker lock(&m_dataMutex);
-    m_queue->enqueue(m_tid);
+    // Before queueing, since a worker may start the transaction right away
     setStatus(QApt::WaitingStatus);
+    m_queue->enqueue(m_tid);
+}
+
+bool Transaction::setup(const QVariantMap &properties)
+{
+    // The setters report errors with sendErrorReply(), which is only valid
+    // during a D-Bus call to this object, so validate everything up front
+    for (auto iter = properties.constBegin(); iter != properties.constEnd(); ++iter) {
+        const QString &name = iter.key();
+
+        if (name == QLatin1String("debconfPipe")) {
+            QFileInfo pipeInfo(iter.value().toString());
+
+            if (!pipeInfo.exists() || (int)pipeInfo.ownerId() != m_uid)
+                return false;
+        } else if (name == QLatin1String("priority")) {
+            const int priority = iter.value().toInt();
+
+            if (priority < QApt::BackgroundPriority || priority > QApt::InteractivePriority)
+                return false;
+        } else if (name == QLatin1String("queueMode") ||
+                   name == QLatin1String("maxParallelDownloads") ||
+                   name == QLatin1String("pipelineDepth") ||
+                   name == QLatin1String("downloadRetries")) {
+            if (!isValidAcquireSetting(name, iter.value()))
+                return false;
+        } else if (name == QLatin1String("downloadLimit")) {
+            bool ok = false;
+            const qlonglong limit = iter.value().toLongLong(&ok);
+
+            if (!ok || limit < 0)
+                return false;
+        } else if (name != QLatin1String("locale") &&
+                   name != QLatin1String("proxy") &&
+                   name != QLatin1String("frontendCaps") &&
+                   name != QLatin1String("updateInterval") &&
+                   name != QLatin1String("filePath") &&
+                   name != QLatin1String("streamingInstall") &&
+                   name != QLatin1String("coalescable") &&
+                   name != QLatin1String("safeUpgrade")) {
+            return false;
+        }
+    }
+
+    for (auto iter = properties.constBegin(); iter != properties.constEnd(); ++iter) {
+        const QString &name = iter.key();
+        const QVariant &value = iter.value();
+
+        if (name == QLatin1String("locale"))
+            setLocale(value.toString());
+        else if (name == QLatin1String("proxy"))
+            setProxy(value.toString());
+        else if (name == QLatin1String("debconfPipe"))
+            setDebconfPipe(value.toString());
+        else if (name == QLatin1String("frontendCaps"))
+            setFrontendCaps(value.toInt());
+        else if (name == QLatin1String("updateInterval"))
+            setUpdateInterval(value.toInt());
+        else if (name == QLatin1String("filePath"))
+            setFilePath(value.toString());
+        else if (name == QLatin1String("priority"))
+            setPriority(value.toInt());
+        else if (name == QLatin1String("streamingInstall"))
+            setStreamingInstall(value.toBool());
+        else if (name == QLatin1String("coalescable"))
+            setCoalescable(value.toBool());
+        else if (name == QLatin1String("queueMode"))
+            setQueueMode(value.toString());
+        else if (name == QLatin1String("maxParallelDownloads"))
+            setMaxParallelDownloads(value.toInt());
+        else if (name == QLatin1String("pipelineDepth"))
+            setPipelineDepth(value.toInt());
+        else if (name == QLatin1String("downloadRetries"))
+            setDownloadRetries(value.toInt());
+        else if (name == QLatin1String("downloadLimit"))
+            setDownloadLimit(value.toULongLong());
+        else if (name == QLatin1String("safeUpgrade"))
+            setSafeUpgrade(value.toBool());
+    }
+
+    return true;
+}
+
+QVariantMap Transaction::snapshot()
+{
+    QVariantMap properties;
+    const QMetaObject *meta = metaObject();
+
+    for (int i = meta->propertyOffset(); i < meta->propertyCount(); ++i) {
+        QMetaProperty property = meta->property(i);
+        properties.insert(QLatin1String(property.name()), property.read(this));
+    }
+
+    return properties;
 }
 
 int Transaction::dbusSenderUid() const
@@ -505,23 +832,30 @@ int Transaction::dbusSenderUid() const
 
 bool Transaction::isForeignUser() const
 {
+    // Only the owner gets to attach a peer connection
+    if (!m_peerConnectionName.isEmpty() && connection().name() == m_peerConnectionName)
+        return false;
+
     return dbusSenderUid() != m_uid;
 }
 
-bool Transaction::authorizeRun()
+void Transaction::authorizeRun(const QDBusConnection &connection, const QDBusMessage &message,
+                               const char *member)
 {
     m_dataMutex.lock();
     QString action = m_roleActionMap.value(m_role);
+    m_isAuthorizing = true;
     m_dataMutex.unlock();
 
     // Some actions don't need authorizing, and are run in the worker
-    // for the sake of asynchronicity.
-    if (action.isEmpty())
-        return true;
-
-    setStatus(QApt::AuthenticationStatus);
-
-    return QApt::Auth::authorize(action, m_service);
+    // for the sake of asynchronicity. The authorizer lets them through.
+    if (!action.isEmpty())
+        setStatus(QApt::AuthenticationStatus);
+
+    // Authorize without blocking, the user may take a while to answer
+    AuthorizationRequest *request = Authorizer::instance()->authorize(action, m_service);
+    request->setCaller(connection, message);
+    connect(request, SIGNAL(finished(bool)), this, member);
 }
 
 void Transaction::setProperty(int property, QDBusVariant value)
@@ -559,6 +893,33 @@ void Transaction::setProperty(int property, QDBusVariant value)
     case QApt::FrontendCapsProperty:
         setFrontendCaps(value.variant().toInt());
         break;
+    case QApt::UpdateIntervalProperty:
+        setUpdateInterval(value.variant().toInt());
+        break;
+    case QApt::PriorityProperty:
+        setPriority(value.variant().toInt());
+        break;
+    case QApt::StreamingInstallProperty:
+        setStreamingInstall(value.variant().toBool());
+        break;
+    case QApt::CoalescableProperty:
+        setCoalescable(value.variant().toBool());
+        break;
+    case QApt::QueueModeProperty:
+        setQueueMode(value.variant().toString());
+        break;
+    case QApt::MaxParallelDownloadsProperty:
+        setMaxParallelDownloads(value.variant().toInt());
+        break;
+    case QApt::PipelineDepthProperty:
+        setPipelineDepth(value.variant().toInt());
+        break;
+    case QApt::DownloadRetriesProperty:
+        setDownloadRetries(value.variant().toInt());
+        break;
+    case QApt::DownloadLimitProperty:
+        setDownloadLimit(value.variant().toULongLong());
+        break;
     default:
         sendErrorReply(QDBusError::InvalidArgs);
         break;
@@ -568,23 +929,44 @@ void Transaction::setProperty(int property, QDBusVariant value)
 void Transaction::cancel()
 {
     if (isForeignUser()) {
-        if (!QApt::Auth::authorize(dbusActionUri("foreigncancel"),
-                                   QLatin1String(s_workerReverseDomainName))) {
-            sendErrorReply(QDBusError::AccessDenied);
-            return;
-        }
+        setDelayedReply(true);
+
+        AuthorizationRequest *request =
+                Authorizer::instance()->authorize(dbusActionUri("foreigncancel"),
+                                                  QLatin1String(s_workerReverseDomainName));
+        request->setCaller(connection(), message());
+        connect(request, SIGNAL(finished(bool)), this, SLOT(foreignCancelAuthorized(bool)));
+        return;
     }
 
+    if (!cancelTransaction())
+        sendErrorReply(QDBusError::Failed);
+}
+
+void Transaction::foreignCancelAuthorized(bool authorized)
+{
+    AuthorizationRequest *request = qobject_cast<AuthorizationRequest *>(sender());
+
+    if (!authorized)
+        request->sendErrorReply(QDBusError::AccessDenied);
+    else if (!cancelTransaction())
+        request->sendErrorReply(QDBusError::Failed);
+    else
+        request->sendReply();
+}
+
+bool Transaction::cancelTransaction()
+{
     QMutexLocker lock(&m_dataMutex);
     // We can only cancel cancellable transactions, obviously
-    if (!m_isCancellable) {
-        sendErrorReply(QDBusError::Failed);
-        return;
-    }
+    if (!m_isCancellable)
+        return false;
 
     m_isCancelled = true;
-    m_isPaused = false;
-    emit propertyChanged(QApt::CancelledProperty, QDBusVariant(m_isCancelled));
+    setIsPaused(false);
+    emitPropertyChanged(QApt::CancelledProperty, QDBusVariant(m_isCancelled));
+
+    return true;
 }
 
 void Transaction::provideMedium(const QString &medium)
@@ -603,7 +985,7 @@ void Transaction::provideMedium(const QString &medium)
     }
 
     // The medium has now been provided, and the installation should be able to continue
-    m_isPaused = false;
+    setIsPaused(false);
 }
 
 void Transaction::replyUntrustedPrompt(bool approved)
@@ -616,7 +998,7 @@ void Transaction::replyUntrustedPrompt(bool approved)
     }
 
     m_allowUntrusted = approved;
-    m_isPaused = false;
+    setIsPaused(false);
 }
 
 void Transaction::resolveConfigFileConflict(const QString &currentPath, bool replaceFile)
@@ -627,7 +1009,7 @@ void Transaction::resolveConfigFileConflict(const QString &currentPath, bool rep
         replaceFile = false; // Client is buggy, assume keep to be safe
 
     m_replaceConfFile = replaceFile;
-    m_isPaused = false;
+    setIsPaused(false);
 }
 
 void Transaction::setFrontendCaps(int frontendCaps)
@@ -637,6 +1019,471 @@ void Transaction::setFrontendCaps(int frontendCaps)
     m_frontendCaps = (QApt::FrontendCaps)frontendCaps;
 }
 
+int Transaction::priority()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_priority;
+}
+
+void Transaction::setPriority(int priority)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    if (m_status != QApt::SetupStatus ||
+        priority < QApt::BackgroundPriority || priority > QApt::InteractivePriority) {
+        sendErrorReply(QDBusError::Failed);
+        return;
+    }
+
+    m_priority = (QApt::TransactionPriority)priority;
+    emitPropertyChanged(QApt::PriorityProperty, QDBusVariant(priority));
+}
+
+bool Transaction::streamingInstall()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_streamingInstall;
+}
+
+void Transaction::setStreamingInstall(bool streaming)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    if (m_status != QApt::SetupStatus) {
+        sendErrorReply(QDBusError::Failed);
+        return;
+    }
+
+    m_streamingInstall = streaming;
+    emitPropertyChanged(QApt::StreamingInstallProperty, QDBusVariant(streaming));
+}
+
+bool Transaction::isCoalescable()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_isCoalescable;
+}
+
+void Transaction::setCoalescable(bool coalescable)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    if (m_status != QApt::SetupStatus) {
+        sendErrorReply(QDBusError::Failed);
+        return;
+    }
+
+    m_isCoalescable = coalescable;
+    emitPropertyChanged(QApt::CoalescableProperty, QDBusVariant(coalescable));
+}
+
+QString Transaction::queueMode()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_queueMode;
+}
+
+void Transaction::setQueueMode(const QString &mode)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    if (m_status != QApt::SetupStatus ||
+        !isValidAcquireSetting(QLatin1String("queueMode"), mode)) {
+        sendErrorReply(QDBusError::Failed);
+        return;
+    }
+
+    m_queueMode = mode;
+    emitPropertyChanged(QApt::QueueModeProperty, QDBusVariant(mode));
+}
+
+int Transaction::maxParallelDownloads()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_maxParallelDownloads;
+}
+
+void Transaction::setMaxParallelDownloads(int count)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    if (m_status != QApt::SetupStatus ||
+        !isValidAcquireSetting(QLatin1String("maxParallelDownloads"), count)) {
+        sendErrorReply(QDBusError::Failed);
+        return;
+    }
+
+    m_maxParallelDownloads = count;
+    emitPropertyChanged(QApt::MaxParallelDownloadsProperty, QDBusVariant(count));
+}
+
+int Transaction::pipelineDepth()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_pipelineDepth;
+}
+
+void Transaction::setPipelineDepth(int depth)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    if (m_status != QApt::SetupStatus ||
+        !isValidAcquireSetting(QLatin1String("pipelineDepth"), depth)) {
+        sendErrorReply(QDBusError::Failed);
+        return;
+    }
+
+    m_pipelineDepth = depth;
+    emitPropertyChanged(QApt::PipelineDepthProperty, QDBusVariant(depth));
+}
+
+int Transaction::downloadRetries()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_downloadRetries;
+}
+
+void Transaction::setDownloadRetries(int retries)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    if (m_status != QApt::SetupStatus ||
+        !isValidAcquireSetting(QLatin1String("downloadRetries"), retries)) {
+        sendErrorReply(QDBusError::Failed);
+        return;
+    }
+
+    m_downloadRetries = retries;
+    emitPropertyChanged(QApt::DownloadRetriesProperty, QDBusVariant(retries));
+}
+
+quint64 Transaction::downloadLimit()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_downloadLimit;
+}
+
+void Transaction::setDownloadLimit(quint64 limit)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    // Unlike the other download settings, the limit can be changed while
+    // the transaction downloads. WorkerAcquire picks it up on its next pulse
+    if (m_status == QApt::FinishedStatus) {
+        sendErrorReply(QDBusError::Failed);
+        return;
+    }
+
+    m_downloadLimit = limit;
+    emitPropertyChanged(QApt::DownloadLimitProperty, QDBusVariant(limit));
+}
+
+void Transaction::setBandwidthYielding(bool yielding)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    m_bandwidthYielding = yielding;
+}
+
+quint64 Transaction::effectiveDownloadLimit()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    if (m_bandwidthYielding && (m_downloadLimit == 0 || m_downloadLimit > YIELDING_DOWNLOAD_LIMIT))
+        return YIELDING_DOWNLOAD_LIMIT;
+
+    return m_downloadLimit;
+}
+
+bool Transaction::hasAcquireSettings()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return (!m_queueMode.isEmpty() || m_maxParallelDownloads >= 0 ||
+            m_pipelineDepth >= 0 || m_downloadRetries >= 0);
+}
+
+bool Transaction::isValidAcquireSetting(const QString &name, const QVariant &value)
+{
+    // Empty and -1 stand for the APT configuration. The limits keep a single
+    // transaction from flooding mirrors
+    if (name == QLatin1String("queueMode")) {
+        const QString mode = value.toString();
+
+        return (mode.isEmpty() || mode == QLatin1String("host") ||
+                mode == QLatin1String("access"));
+    }
+
+    bool ok = false;
+    const int number = value.toInt(&ok);
+
+    if (!ok || number == -1)
+        return ok;
+
+    if (name == QLatin1String("maxParallelDownloads"))
+        return (number >= 1 && number <= 64);
+    else if (name == QLatin1String("pipelineDepth"))
+        return (number >= 0 && number <= 100);
+    else if (name == QLatin1String("downloadRetries"))
+        return (number >= 0 && number <= 20);
+
+    return false;
+}
+
+void Transaction::setPreemptionRequested(bool requested)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    m_preemptionRequested = requested;
+}
+
+bool Transaction::preemptIfRequested()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    // A cancelled member stops the run even after the download, so that
+    // its changes aren't made
+    bool memberCancelled = false;
+    for (Transaction *member : m_coalesced)
+        memberCancelled |= member->isCancelled();
+
+    if (!m_isPreempted && !m_isCancelled && m_status == QApt::DownloadingStatus &&
+        ((m_preemptionRequested && m_isCancellable) || memberCancelled)) {
+        m_isPreempted = true;
+    }
+
+    return m_isPreempted;
+}
+
+bool Transaction::isPreempted()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_isPreempted;
+}
+
+void Transaction::requeue()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    m_isPreempted = false;
+    m_preemptionRequested = false;
+    setStatus(QApt::WaitingStatus);
+
+    emit preempted();
+}
+
+void Transaction::setCoalesced(const QList<Transaction *> &members)
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    m_coalesced = members;
+}
+
+QList<Transaction *> Transaction::coalesced()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    return m_coalesced;
+}
+
+QList<Transaction *> Transaction::takeCoalesced()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    QList<Transaction *> members;
+    members.swap(m_coalesced);
+
+    return members;
+}
+
+QVariantMap Transaction::coalescedPackages()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    QVariantMap packages = m_packages;
+    for (Transaction *member : m_coalesced)
+        packages.insert(member->packages());
+
+    return packages;
+}
+
+int Transaction::updateInterval()
+{
+    QMutexLocker lock(&m_emitMutex);
+
+    return m_updateInterval;
+}
+
+void Transaction::setUpdateInterval(int interval)
+{
+    QMutexLocker lock(&m_emitMutex);
+
+    m_updateInterval = qMax(0, interval);
+    m_flushTimer->setInterval(m_updateInterval);
+
+    if (!m_updateInterval)
+        emitPendingChanges();
+
+    emit propertyChanged(QApt::UpdateIntervalProperty, QDBusVariant(m_updateInterval));
+}
+
+void Transaction::emitPropertyChanged(int property, const QDBusVariant &value)
+{
+    QMutexLocker lock(&m_emitMutex);
+
+    // Clients must see the latest progress before e.g. a status change
+    emitPendingChanges();
+    emit propertyChanged(property, value);
+}
+
+void Transaction::queuePropertyChange(int property, const QDBusVariant &value)
+{
+    QMutexLocker lock(&m_emitMutex);
+
+    if (!m_updateInterval) {
+        emit propertyChanged(property, value);
+        return;
+    }
+
+    // The timer lives in the main thread
+    if (m_pendingChanges.isEmpty())
+        QMetaObject::invokeMethod(m_flushTimer, "start", Qt::QueuedConnection);
+
+    const QString key = QString::number(property);
+
+    // Download items are sent as deltas, which have to be merged
+    if (property == QApt::DownloadItemsProperty && m_pendingChanges.contains(key)) {
+        QApt::DownloadProgressList items = m_pendingChanges.value(key).value<QApt::DownloadProgressList>();
+        mergeDownloadItems(items, value.variant().value<QApt::DownloadProgressList>());
+        m_pendingChanges.insert(key, QVariant::fromValue(items));
+        return;
+    }
+
+    m_pendingChanges.insert(key, value.variant());
+}
+
+void Transaction::mergeDownloadItems(QApt::DownloadProgressList &items,
+                                     const QApt::DownloadProgressList &changedItems)
+{
+    for (const QApt::DownloadProgress &changed : changedItems) {
+        auto iter = std::find_if(items.begin(), items.end(),
+                                 [&changed](const QApt::DownloadProgress &item) {
+            return item.uri() == changed.uri();
+        });
+
+        if (iter != items.end())
+            *iter = changed;
+        else
+            items.append(changed);
+    }
+}
+
+void Transaction::flushPropertyChanges()
+{
+    QMutexLocker lock(&m_emitMutex);
+
+    emitPendingChanges();
+}
+
+void Transaction::emitPendingChanges()
+{
+    if (m_pendingChanges.isEmpty())
+        return;
+
+    emit propertiesChanged(m_pendingChanges);
+    m_pendingChanges.clear();
+}
+
+QByteArray Transaction::terminalOutput(qulonglong offset, qulonglong &start)
+{
+    if (isForeignUser()) {
+        sendErrorReply(QDBusError::AccessDenied);
+        return QByteArray();
+    }
+
+    QMutexLocker lock(&m_dataMutex);
+
+    quint64 chunkStart;
+    QByteArray chunk = m_terminalLog.read(offset, &chunkStart);
+    start = chunkStart;
+
+    return chunk;
+}
+
+void Transaction::setPeerServer(PeerServer *server)
+{
+    m_peerServer = server;
+}
+
+QString Transaction::requestPeerConnection(QString &token)
+{
+    if (isForeignUser()) {
+        sendErrorReply(QDBusError::AccessDenied);
+        return QString();
+    }
+
+    const QString address = m_peerServer ? m_peerServer->listen() : QString();
+    if (address.isEmpty() || !m_peerConnectionName.isEmpty()) {
+        sendErrorReply(QDBusError::Failed);
+        return QString();
+    }
+
+    token = m_peerServer->createToken(this);
+
+    return address;
+}
+
+bool Transaction::attachPeer(const QDBusConnection &connection)
+{
+    if (!m_peerConnectionName.isEmpty())
+        return false;
+
+    QDBusConnection peer(connection);
+    if (!peer.registerObject(m_tid, this)) {
+        qWarning() << "Unable to register transaction on peer connection";
+        return false;
+    }
+
+    m_peerConnectionName = peer.name();
+    QDBusConnection::systemBus().unregisterObject(m_tid);
+
+    // Go back to the system bus if the peer goes away
+    peer.connect(QString(), QLatin1String("/org/freedesktop/DBus/Local"),
+                 QLatin1String("org.freedesktop.DBus.Local"),
+                 QLatin1String("Disconnected"), this, SLOT(peerDisconnected()));
+
+    return true;
+}
+
+void Transaction::peerDisconnected()
+{
+    if (m_peerConnectionName.isEmpty())
+        return;
+
+    QDBusConnection(m_peerConnectionName).unregisterObject(m_tid);
+    m_peerConnectionName.clear();
+
+    if (!QDBusConnection::systemBus().registerObject(m_tid, this))
+        qWarning() << "Unable to register transaction on DBus";
+}
+
+void Transaction::emitTerminalOutputSize()
+{
+    QMutexLocker lock(&m_dataMutex);
+
+    m_terminalNotifyPending = false;
+    emitPropertyChanged(QApt::TerminalOutputSizeProperty, QDBusVariant(m_terminalLog.size()));
+}
+
 void Transaction::emitIdleTimeout()
 {
     emit idleTimeout(this);
@@ -23,16 +23,20 @@
 #define TRANSACTION_H
 
 // Qt includes
+#include <QHash>
 #include <QMutex>
 #include <QObject>
 #include <QDBusContext>
 #include <QDBusVariant>
+#include <QWaitCondition>
 #include <qmutex.h>
 
 // Own includes
 #include "downloadprogress.h"
+#include "terminallog.h"
 
 class QTimer;
+class PeerServer;
 class TransactionQueue;
 
 class Transaction : public QObject, protected QDBusContext
@@ -62,6 +66,19 @@ class Transaction : public QObject, protected QDBusContext
     Q_PROPERTY(QString filePath READ filePath)
     Q_PROPERTY(QString errorDetails READ errorDetails)
     Q_PROPERTY(int frontendCaps READ frontendCaps)
+    Q_PROPERTY(int lockHolderPid READ lockHolderPid)
+    Q_PROPERTY(QString lockHolderCommand READ lockHolderCommand)
+    Q_PROPERTY(quint64 terminalOutputSize READ terminalOutputSize)
+    Q_PROPERTY(int updateInterval READ updateInterval)
+    Q_PROPERTY(QApt::DownloadProgressList downloadItems READ downloadItems)
+    Q_PROPERTY(int priority READ priority)
+    Q_PROPERTY(bool streamingInstall READ streamingInstall)
+    Q_PROPERTY(bool coalescable READ isCoalescable)
+    Q_PROPERTY(QString queueMode READ queueMode)
+    Q_PROPERTY(int maxParallelDownloads READ maxParallelDownloads)
+    Q_PROPERTY(int pipelineDepth READ pipelineDepth)
+    Q_PROPERTY(int downloadRetries READ downloadRetries)
+    Q_PROPERTY(quint64 downloadLimit READ downloadLimit)
 public:
     Transaction(TransactionQueue *queue, int userId);
     Transaction(TransactionQueue *queue, int userId,
@@ -95,6 +112,26 @@ public:
     bool safeUpgrade() const;
     bool replaceConfFile() const;
     int frontendCaps() const;
+    int lockHolderPid();
+    QString lockHolderCommand();
+    quint64 terminalOutputSize();
+    int updateInterval();
+    QApt::DownloadProgressList downloadItems();
+    int priority();
+    bool streamingInstall();
+    bool isCoalescable();
+    QString queueMode();
+    int maxParallelDownloads();
+    int pipelineDepth();
+    int downloadRetries();
+    quint64 downloadLimit();
+
+    /**
+     * Returns whether any of the download settings differs from the APT
+     * configuration. They are applied to the process-wide configuration
+     * while the transaction downloads, see WorkerAcquire.
+     */
+    bool hasAcquireSettings();
 
     void setStatus(QApt::TransactionStatus status);
     void setError(QApt::ErrorCode code);
@@ -102,6 +139,13 @@ public:
     void setExitStatus(QApt::ExitStatus exitStatus);
     void setMediumRequired(const QString &label, const QString &medium);
     void setIsPaused(bool paused);
+
+    /**
+     * Blocks the calling thread until the transaction is no longer paused,
+     * e.g. because the client replied to a prompt or the transaction has
+     * been cancelled.
+     */
+    void waitWhilePaused();
     void setStatusDetails(const QString &details);
     void setProgress(int progress);
     void setService(const QString &service);
@@ -114,10 +158,105 @@ public:
     void setSafeUpgrade(bool safeUpgrade);
     void setConfFileConflict(const QString &currentPath, const QString &newPath);
     void setFrontendCaps(int frontendCaps);
+    void setLockHolder(int pid, const QString &command);
+    void appendTerminalOutput(const char *data, int size);
+    void appendTerminalOutput(const QByteArray &data);
+    void setUpdateInterval(int interval);
+    void setDownloadItems(const QApt::DownloadProgressList &changedItems);
+    void setPeerServer(PeerServer *server);
+
+    /**
+     * Asks the transaction to make way for a transaction of a higher
+     * priority. The request is only honored while the transaction is
+     * downloading and can be cancelled, see preemptIfRequested().
+     */
+    void setPreemptionRequested(bool requested);
+
+    /**
+     * Called by the worker at points where the transaction can be
+     * interrupted. If preemption has been requested and the transaction is
+     * in a cancellable download, it is marked as preempted.
+     *
+     * @return @c true if the transaction is preempted and should stop
+     */
+    bool preemptIfRequested();
+    bool isPreempted();
+
+    /**
+     * Makes the transaction give up most of its bandwidth to a transaction
+     * of a higher priority that is downloading at the same time.
+     */
+    void setBandwidthYielding(bool yielding);
+
+    /**
+     * Returns the download rate to keep to in bytes per second, 0 if
+     * unlimited. This is the download limit of the transaction, lowered
+     * while it yields its bandwidth.
+     */
+    quint64 effectiveDownloadLimit();
+
+    /**
+     * Puts a preempted transaction, or one taken back from a coalesced run,
+     * into the waiting state, and tells the queue to run it again later.
+     * Partial downloads are resumed then.
+     */
+    void requeue();
+
+    /**
+     * Lets this commit transaction make the changes of the @p members as
+     * well, in the same run. The members mirror the status, progress and
+     * errors of this transaction until they are taken back with
+     * takeCoalesced(). A member being cancelled stops the run at the next
+     * point where it can be interrupted, like preemption does.
+     */
+    void setCoalesced(const QList<Transaction *> &members);
+    QList<Transaction *> coalesced();
+    QList<Transaction *> takeCoalesced();
+
+    /// Returns the packages of this transaction and of its members
+    QVariantMap coalescedPackages();
+
+    /**
+     * Makes the transaction available on the peer-to-peer @p connection
+     * instead of the system bus. Calls over that connection are treated as
+     * coming from the owner of the transaction.
+     */
+    bool attachPeer(const QDBusConnection &connection);
+
+    /**
+     * Applies the setup properties of a transaction that is started in a
+     * single call. Keys are the names of the D-Bus properties (locale,
+     * proxy, debconfPipe, frontendCaps, updateInterval, filePath, priority,
+     * streamingInstall, coalescable, queueMode, maxParallelDownloads,
+     * pipelineDepth, downloadRetries, downloadLimit) plus safeUpgrade for
+     * system upgrades.
+     *
+     * @return @c false if a property is unknown or has an invalid value
+     */
+    bool setup(const QVariantMap &properties);
+
+    /**
+     * Authorizes the transaction and puts it in the queue. The reply to the
+     * D-Bus call @p message is delayed until authorization is done. It is
+     * the snapshot() of the transaction, or an error if authorization
+     * failed, in which case the transaction is dropped.
+     */
+    void start(const QDBusConnection &connection, const QDBusMessage &message);
+
+    /// Returns all D-Bus properties of the transaction, keyed by name
+    QVariantMap snapshot();
+
+    /**
+     * Puts the transaction in the queue without authorizing it. Only for
+     * transactions that need no authorization, and that the worker starts
+     * on behalf of a client.
+     */
+    void enqueue();
 
 private:
     // Pointers to external containers
     TransactionQueue *m_queue;
+    PeerServer *m_peerServer;
 
     // Transaction data
     QString m_tid;
@@ -147,12 +286,44 @@ private:
     QString m_currentConfPath;
     bool m_replaceConfFile;
     QApt::FrontendCaps m_frontendCaps;
+    int m_lockHolderPid;
+    QString m_lockHolderCommand;
+    TerminalLog m_terminalLog;
+    QApt::DownloadProgressList m_downloadItems;
+    QHash<QString, int> m_downloadItemIndex;
+    QApt::TransactionPriority m_priority;
+    bool m_preemptionRequested;
+    bool m_isPreempted;
+    bool m_streamingInstall;
+    bool m_isCoalescable;
+    QString m_queueMode;
+    int m_maxParallelDownloads;
+    int m_pipelineDepth;
+    int m_downloadRetries;
+    quint64 m_downloadLimit;
+    bool m_bandwidthYielding;
+    // Whether run() or start() waits for authorization
+    bool m_isAuthorizing;
+    QList<Transaction *> m_coalesced;
 
     // Other data
     QMap<int, QString> m_roleActionMap;
     QTimer *m_idleTimer;
+    QTimer *m_terminalTimer;
+    bool m_terminalNotifyPending;
+
+    // Coalescing of frequently changing properties. Take m_emitMutex
+    // after m_dataMutex when both are needed
+    QMutex m_emitMutex;
+    QTimer *m_flushTimer;
+    int m_updateInterval;
+    QVariantMap m_pendingChanges;
     QRecursiveMutex m_dataMutex;
+    // Guards m_isPaused. Take it after m_dataMutex when both are needed
+    QMutex m_pauseMutex;
+    QWaitCondition m_pauseCondition;
     QString m_service;
+    QString m_peerConnectionName;
 
     // Private functions
     int dbusSenderUid() const;
@@ -162,15 +333,42 @@ private:
     void setProxy(QString proxy);
     void setDebconfPipe(QString pipe);
     void setPackages(QVariantMap packageList);
-    bool authorizeRun();
+    void setPriority(int priority);
+    void setStreamingInstall(bool streaming);
+    void setCoalescable(bool coalescable);
+    void setQueueMode(const QString &mode);
+    void setMaxParallelDownloads(int count);
+    void setPipelineDepth(int depth);
+    void setDownloadRetries(int retries);
+    void setDownloadLimit(quint64 limit);
+    static bool isValidAcquireSetting(const QString &name, const QVariant &value);
+    void authorizeRun(const QDBusConnection &connection, const QDBusMessage &message,
+                      const char *member);
+    bool cancelTransaction();
+
+    /**
+     * Emits a property change right away, after any queued changes.
+     */
+    void emitPropertyChanged(int property, const QDBusVariant &value);
+
+    /**
+     * Queues a property change to be emitted with other changes in one
+     * propertiesChanged() signal after the update interval.
+     */
+    void queuePropertyChange(int property, const QDBusVariant &value);
+    void emitPendingChanges();
+    static void mergeDownloadItems(QApt::DownloadProgressList &items,
+                                   const QApt::DownloadProgressList &changedItems);
 
 Q_SIGNALS:
     Q_SCRIPTABLE void propertyChanged(int role, QDBusVariant newValue);
+    Q_SCRIPTABLE void propertiesChanged(QVariantMap changes);
     Q_SCRIPTABLE void finished(int exitStatus);
     Q_SCRIPTABLE void mediumRequired(QString label, QString mountPoint);
     Q_SCRIPTABLE void promptUntrusted(QStringList untrustedPackages);
     Q_SCRIPTABLE void configFileConflict(QString currentPath, QString newPath);
     void idleTimeout(Transaction *trans);
+    void preempted();
     
 public Q_SLOTS:
     void setProperty(int property, QDBusVariant value);
@@ -179,9 +377,17 @@ public Q_SLOTS:
     void provideMedium(const QString &medium);
     void replyUntrustedPrompt(bool approved);
     void resolveConfigFileConflict(const QString &currentPath, bool replaceFile);
+    QByteArray terminalOutput(qulonglong offset, qulonglong &start);
+    QString requestPeerConnection(QString &token);
 
 private Q_SLOTS:
     void emitIdleTimeout();
+    void emitTerminalOutputSize();
+    void flushPropertyChanges();
+    void peerDisconnected();
+    void runAuthorized(bool authorized);
+    void startAuthorized(bool authorized);
+    void foreignCancelAuthorized(bool authorized);
 };
 
 #endif // TRANSACTION_H
@@ -23,17 +23,61 @@
 
 // Qt includes
 #include <QStringList>
+#include <QThread>
 #include <QTimer>
 
 // Own includes
 #include "aptworker.h"
+#include "archiveprefetcher.h"
 #include "transaction.hpp"
 
-TransactionQueue::TransactionQueue(QObject *parent, AptWorker *worker)
+TransactionQueue::TransactionQueue(QObject *parent, int workerCount)
     : QObject(parent)
-    , m_worker(worker)
-    , m_activeTransaction(nullptr)
+    , m_scheduler(workerCount)
+    , m_paused(false)
 {
+    for (int i = 0; i < m_scheduler.maxRunning(); ++i) {
+        AptWorker *worker = new AptWorker(nullptr);
+        QThread *thread = new QThread(this);
+
+        worker->moveToThread(thread);
+        connect(thread, SIGNAL(finished()), worker, SLOT(deleteLater()));
+        thread->start();
+
+        // Invoke with Qt::QueuedConnection since the Qt event loop isn't up yet
+        QMetaObject::invokeMethod(worker, "init", Qt::QueuedConnection);
+
+        m_workers.append(worker);
+        m_threads.append(thread);
+    }
+
+    // The prefetcher doesn't take a slot of the scheduler, it only uses the
+    // network while the workers install
+    m_prefetcher = new ArchivePrefetcher(nullptr);
+    QThread *thread = new QThread(this);
+
+    m_prefetcher->moveToThread(thread);
+    connect(thread, SIGNAL(finished()), m_prefetcher, SLOT(deleteLater()));
+    connect(m_prefetcher, SIGNAL(finished(QString,bool)),
+            this, SLOT(onPrefetchFinished(QString,bool)));
+    thread->start();
+
+    m_threads.append(thread);
+}
+
+TransactionQueue::~TransactionQueue()
+{
+    stop();
+}
+
+void TransactionQueue::stop()
+{
+    cancelPrefetch(m_prefetchTid);
+
+    for (QThread *thread : m_threads) {
+        thread->quit();
+        thread->wait();
+    }
 }
 
 QList<Transaction *> TransactionQueue::transactions() const
@@ -41,9 +85,9 @@ QList<Transaction *> TransactionQueue::transactions() const
     return m_queue;
 }
 
-Transaction *TransactionQueue::activeTransaction() const
+QList<Transaction *> TransactionQueue::activeTransactions() const
 {
-    return m_activeTransaction;
+    return m_active.keys();
 }
 
 bool TransactionQueue::isEmpty() const
@@ -51,6 +95,31 @@ bool TransactionQueue::isEmpty() const
     return (m_queue.isEmpty() && m_pending.isEmpty());
 }
 
+bool TransactionQueue::pause()
+{
+    if (!isEmpty())
+        return false;
+
+    m_paused = true;
+    return true;
+}
+
+void TransactionQueue::resume()
+{
+    m_paused = false;
+    runNextTransactions();
+}
+
+quint64 TransactionQueue::lastActiveTimestamp() const
+{
+    quint64 timestamp = 0;
+
+    for (AptWorker *worker : m_workers)
+        timestamp = qMax(timestamp, worker->lastActiveTimestamp());
+
+    return timestamp;
+}
+
 Transaction *TransactionQueue::pendingTransactionById(const QString &id) const
 {
     Transaction *transaction = nullptr;
@@ -79,6 +148,37 @@ Transaction *TransactionQueue::transactionById(const QString &id) const
     return transaction;
 }
 
+AptWorker *TransactionQueue::idleWorker() const
+{
+    for (AptWorker *worker : m_workers) {
+        bool busy = false;
+        for (AptWorker *activeWorker : m_active) {
+            if (activeWorker == worker) {
+                busy = true;
+                break;
+            }
+        }
+
+        if (!busy)
+            return worker;
+    }
+
+    return nullptr;
+}
+
+TransactionScheduler::Resources TransactionQueue::transactionResources(Transaction *trans) const
+{
+    TransactionScheduler::Resources resources =
+            TransactionScheduler::roleResources((QApt::TransactionRole)trans->role());
+
+    // Proxies and download settings are passed to the download methods
+    // through the APT configuration, which all workers share
+    if (!trans->proxy().isEmpty() || trans->hasAcquireSettings())
+        resources |= TransactionScheduler::ExclusiveResource;
+
+    return resources;
+}
+
 void TransactionQueue::addPending(Transaction *trans)
 {
     m_pending.append(trans);
@@ -101,16 +201,15 @@ void TransactionQueue::enqueue(QString tid)
         return;
 
     connect(trans, SIGNAL(finished(int)), this, SLOT(onTransactionFinished()));
+    connect(trans, SIGNAL(preempted()), this, SLOT(onTransactionPreempted()));
+    connect(trans, SIGNAL(propertyChanged(int,QDBusVariant)),
+            this, SLOT(onTransactionPropertyChanged(int,QDBusVariant)));
     m_pending.removeAll(trans);
-    m_queue.enqueue(trans);
-
-    if (!m_worker->currentTransaction())
-        runNextTransaction();
-    else {
-        trans->setStatus(QApt::WaitingStatus);
-    }
+    m_queue.append(trans);
+    m_scheduler.enqueue(tid, transactionResources(trans),
+                        (QApt::TransactionPriority)trans->priority());
 
-    emitQueueChanged();
+    runNextTransactions();
 }
 
 void TransactionQueue::remove(QString tid)
@@ -121,9 +220,12 @@ void TransactionQueue::remove(QString tid)
         return;
 
     m_queue.removeAll(trans);
-
-    if (trans == m_activeTransaction)
-        m_activeTransaction = nullptr;
+    m_active.remove(trans);
+    m_waitingForPrefetch.removeAll(trans);
+    m_scheduler.remove(tid);
+    m_scheduler.finish(tid);
+    m_prefetched.remove(tid);
+    cancelPrefetch(tid);
 
     emitQueueChanged();
 
@@ -138,32 +240,275 @@ void TransactionQueue::onTransactionFinished()
     if (!trans) // Don't want no trouble...
         return;
 
-    // TODO: Transaction chaining
-
     remove(trans->transactionId());
-    if (m_queue.count())
-        runNextTransaction();
+    runNextTransactions();
+}
+
+void TransactionQueue::onTransactionPreempted()
+{
+    Transaction *trans = qobject_cast<Transaction *>(sender());
+
+    if (!trans)
+        return;
+
+    // The worker has released the transaction's locks
+    m_active.remove(trans);
+    m_scheduler.requeue(trans->transactionId());
+    runNextTransactions();
+}
+
+void TransactionQueue::runNextTransactions()
+{
+    if (m_paused) {
+        emitQueueChanged();
+        return;
+    }
+
+    const QStringList started = m_scheduler.schedule();
+
+    for (const QString &tid : started) {
+        Transaction *trans = transactionById(tid);
+        AptWorker *worker = idleWorker();
+
+        // The scheduler never runs more transactions than there are workers
+        Q_ASSERT(worker);
+
+        m_active.insert(trans, worker);
+        coalesceQueued(trans);
+
+        const TransactionScheduler::Resources resources = transactionResources(trans);
+
+        // Two downloads into the archive cache would get in each other's way.
+        // The transaction resumes whatever has been prefetched by itself.
+        // Transactions that run alone may change the shared configuration
+        if (!m_prefetchTid.isEmpty() &&
+            (resources & (TransactionScheduler::ArchivesResource | TransactionScheduler::ExclusiveResource))) {
+            cancelPrefetch(m_prefetchTid);
+            m_waitingForPrefetch.append(trans);
+            continue;
+        }
+
+        runTransaction(trans);
+    }
+
+    // Ask background work in the way of the next transaction to step aside.
+    // Transactions that can't be interrupted right now are asked again
+    // whenever the queue changes
+    const QStringList candidates = m_scheduler.preemptionCandidates();
+    for (Transaction *trans : m_active.keys())
+        trans->setPreemptionRequested(candidates.contains(trans->transactionId()));
+
+    updateBandwidthShares();
+    startPrefetch();
     emitQueueChanged();
 }
 
-void TransactionQueue::runNextTransaction()
+void TransactionQueue::coalesceQueued(Transaction *lead)
+{
+    if (!isCoalescable(lead))
+        return;
+
+    QVariantMap packages = lead->packages();
+    QList<Transaction *> members;
+
+    for (const QString &tid : m_scheduler.queued()) {
+        Transaction *trans = transactionById(tid);
+
+        if (canCoalesce(lead, trans) && mergePackages(packages, trans->packages())) {
+            m_scheduler.coalesce(lead->transactionId(), tid);
+
+            // The archives are downloaded by the lead
+            cancelPrefetch(tid);
+            members.append(trans);
+            continue;
+        }
+
+        // Changes to the package system are made in queue order, so nothing
+        // may overtake a transaction that has to go first
+        if (transactionResources(trans) & transactionResources(lead))
+            break;
+    }
+
+    if (!members.isEmpty())
+        lead->setCoalesced(members);
+}
+
+bool TransactionQueue::isCoalescable(Transaction *trans)
+{
+    // Streaming installs hand batches to dpkg that only fit their own changes
+    return (trans->role() == QApt::CommitChangesRole && trans->isCoalescable() &&
+            !trans->streamingInstall());
+}
+
+bool TransactionQueue::canCoalesce(Transaction *lead, Transaction *trans)
+{
+    // Only the client of the lead is asked about untrusted packages, media
+    // and configuration files, so its answers must not cover other users
+    return (isCoalescable(trans) && !trans->isCancelled() &&
+            trans->userId() == lead->userId() &&
+            trans->locale() == lead->locale() &&
+            trans->proxy() == lead->proxy() &&
+            trans->queueMode() == lead->queueMode() &&
+            trans->maxParallelDownloads() == lead->maxParallelDownloads() &&
+            trans->pipelineDepth() == lead->pipelineDepth() &&
+            trans->downloadRetries() == lead->downloadRetries() &&
+            trans->downloadLimit() == lead->downloadLimit() &&
+            trans->debconfPipe() == lead->debconfPipe() &&
+            trans->frontendCaps() == lead->frontendCaps() &&
+            trans->priority() == lead->priority());
+}
+
+bool TransactionQueue::mergePackages(QVariantMap &packages, const QVariantMap &other)
+{
+    // Keys are package names, optionally followed by a version
+    QHash<QString, QString> keys;
+    for (auto iter = packages.constBegin(); iter != packages.constEnd(); ++iter)
+        keys.insert(iter.key().section(QLatin1Char(','), 0, 0), iter.key());
+
+    // Every package may only be asked for once, or in the same way
+    for (auto iter = other.constBegin(); iter != other.constEnd(); ++iter) {
+        const QString key = keys.value(iter.key().section(QLatin1Char(','), 0, 0));
+
+        if (!key.isEmpty() && (key != iter.key() || packages.value(key) != iter.value()))
+            return false;
+    }
+
+    packages.insert(other);
+
+    return true;
+}
+
+void TransactionQueue::runTransaction(Transaction *trans)
+{
+    QMetaObject::invokeMethod(m_active.value(trans), "runTransaction", Qt::QueuedConnection,
+                              Q_ARG(Transaction *, trans));
+}
+
+void TransactionQueue::onTransactionPropertyChanged(int property, QDBusVariant value)
 {
-    m_activeTransaction = m_queue.head();
+    Transaction *trans = qobject_cast<Transaction *>(sender());
 
-    QMetaObject::invokeMethod(m_worker, "runTransaction", Qt::QueuedConnection,
-                              Q_ARG(Transaction *, m_activeTransaction));
+    if (property == QApt::DownloadLimitProperty) {
+        if (trans && trans->transactionId() == m_prefetchTid)
+            m_prefetcher->setDownloadLimit(m_prefetchTid, value.variant().toULongLong());
+        return;
+    }
+
+    if (property != QApt::StatusProperty)
+        return;
+
+    // Leave the bandwidth to running transactions
+    if (value.variant().toInt() == QApt::DownloadingStatus)
+        cancelPrefetch(m_prefetchTid);
+    else
+        startPrefetch();
+
+    updateBandwidthShares();
+}
+
+void TransactionQueue::updateBandwidthShares()
+{
+    bool contended = false;
+
+    for (Transaction *trans : m_active.keys()) {
+        if (trans->priority() > QApt::BackgroundPriority &&
+            trans->status() == QApt::DownloadingStatus) {
+            contended = true;
+            break;
+        }
+    }
+
+    // Background downloads keep a trickle, so that their connections
+    // survive until the foreground download is done
+    for (Transaction *trans : m_active.keys())
+        trans->setBandwidthYielding(contended && trans->priority() == QApt::BackgroundPriority);
+}
+
+bool TransactionQueue::canPrefetch() const
+{
+    bool installing = false;
+
+    for (Transaction *trans : m_active.keys()) {
+        const int status = trans->status();
+        const bool isInstalling = (status == QApt::CommittingStatus ||
+                                   status == QApt::WaitingConfigFilePromptStatus);
+        const TransactionScheduler::Resources resources =
+                TransactionScheduler::roleResources((QApt::TransactionRole)trans->role());
+
+        // Leave the bandwidth to running transactions, and the archive cache
+        // to those that haven't got their archives yet. Streaming installs
+        // download while installing
+        if (status == QApt::DownloadingStatus || trans->streamingInstall() ||
+            (!isInstalling && (resources & TransactionScheduler::ArchivesResource))) {
+            return false;
+        }
+
+        installing |= isInstalling;
+    }
+
+    return installing;
+}
+
+void TransactionQueue::startPrefetch()
+{
+    if (m_paused || !m_prefetchTid.isEmpty() || !canPrefetch())
+        return;
+
+    for (const QString &tid : m_scheduler.queued()) {
+        Transaction *trans = transactionById(tid);
+        const int role = trans->role();
+
+        if (m_prefetched.contains(tid) || !trans->proxy().isEmpty() ||
+            (role != QApt::CommitChangesRole && role != QApt::UpgradeSystemRole)) {
+            continue;
+        }
+
+        m_prefetchTid = tid;
+        m_prefetcher->setDownloadLimit(tid, trans->downloadLimit());
+        QMetaObject::invokeMethod(m_prefetcher, "prefetch", Qt::QueuedConnection,
+                                  Q_ARG(QString, tid), Q_ARG(int, role),
+                                  Q_ARG(QVariantMap, trans->packages()),
+                                  Q_ARG(bool, trans->safeUpgrade()));
+        return;
+    }
+}
+
+void TransactionQueue::cancelPrefetch(const QString &tid)
+{
+    if (!tid.isEmpty() && tid == m_prefetchTid)
+        m_prefetcher->cancel(tid);
+}
+
+void TransactionQueue::onPrefetchFinished(const QString &tid, bool cancelled)
+{
+    m_prefetchTid.clear();
+
+    for (Transaction *trans : m_waitingForPrefetch)
+        runTransaction(trans);
+    m_waitingForPrefetch.clear();
+
+    // Cancelled prefetches are tried again once the network is free
+    if (!cancelled && transactionById(tid))
+        m_prefetched.insert(tid);
+
+    startPrefetch();
 }
 
 void TransactionQueue::emitQueueChanged()
 {
-    QString tid;
+    // The oldest running transaction is reported as the active one, the
+    // other running ones lead the list of queued transactions. Coalesced
+    // transactions follow the one that carries them
     QStringList queued;
+    for (const QString &running : m_scheduler.running())
+        queued << running << m_scheduler.coalesced(running);
+
+    QString tid;
 
-    if (m_activeTransaction)
-        tid = m_activeTransaction->transactionId();
+    if (!queued.isEmpty())
+        tid = queued.takeFirst();
 
-    for (Transaction *trans : m_queue)
-        queued << trans->transactionId();
+    queued.append(m_scheduler.queued());
 
     emit queueChanged(tid, queued);
 }
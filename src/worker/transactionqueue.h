@@ -22,30 +22,98 @@
 #ifndef TRANSACTIONQUEUE_H
 #define TRANSACTIONQUEUE_H
 
+#include <QDBusVariant>
+#include <QHash>
+#include <QVariantMap>
 #include <QObject>
-#include <QQueue>
+#include <QSet>
+#include <QVector>
+
+#include "transactionscheduler.h"
+
+class QThread;
 
 class AptWorker;
+class ArchivePrefetcher;
 class Transaction;
 
+/**
+ * Keeps track of transactions from their creation until they are done, and
+ * runs queued transactions on a pool of workers, each with its own thread
+ * and package cache. Which transactions run at the same time is decided by
+ * a TransactionScheduler. Background transactions that keep a transaction
+ * of a higher priority from running are asked to make way, see
+ * Transaction::setPreemptionRequested().
+ *
+ * While a transaction is installing and none is downloading, the archives
+ * of queued commits and upgrades are downloaded ahead of time by an
+ * ArchivePrefetcher, one transaction after the other in queue order.
+ *
+ * When a coalescable commit starts, compatible coalescable commits waiting
+ * behind it are carried out in the same run, see
+ * Transaction::setCoalesced().
+ */
 class TransactionQueue : public QObject
 {
     Q_OBJECT
 public:
-    TransactionQueue(QObject *parent, AptWorker *worker);
+    TransactionQueue(QObject *parent, int workerCount);
+    ~TransactionQueue();
 
     QList<Transaction *> transactions() const;
-    Transaction *activeTransaction() const;
+    QList<Transaction *> activeTransactions() const;
     bool isEmpty() const;
+    quint64 lastActiveTimestamp() const;
+
+    /**
+     * Stops the worker threads. Running transactions are not interrupted,
+     * so call this only when the queue is empty.
+     */
+    void stop();
+
+    /**
+     * Keeps transactions from starting until resume() is called, for work
+     * of the worker itself that uses the process-wide APT configuration.
+     *
+     * @return @c false if the queue isn't empty, in which case nothing
+     * changes
+     */
+    bool pause();
+    void resume();
 
 private:
-    AptWorker *m_worker;
-    QQueue<Transaction *> m_queue;
+    QVector<AptWorker *> m_workers;
+    QVector<QThread *> m_threads;
+    TransactionScheduler m_scheduler;
+    QList<Transaction *> m_queue;
     QList<Transaction *> m_pending;
-    Transaction *m_activeTransaction;
+    QHash<Transaction *, AptWorker *> m_active;
+    ArchivePrefetcher *m_prefetcher;
+    QString m_prefetchTid;
+    QSet<QString> m_prefetched;
+    // Transactions that wait for a prefetch to stop before they can use
+    // the archive cache
+    QList<Transaction *> m_waitingForPrefetch;
+    bool m_paused;
 
     Transaction *pendingTransactionById(const QString &id) const;
     Transaction *transactionById(const QString &id) const;
+    AptWorker *idleWorker() const;
+    TransactionScheduler::Resources transactionResources(Transaction *trans) const;
+    void coalesceQueued(Transaction *lead);
+    static bool isCoalescable(Transaction *trans);
+    static bool canCoalesce(Transaction *lead, Transaction *trans);
+    static bool mergePackages(QVariantMap &packages, const QVariantMap &other);
+    void startPrefetch();
+    bool canPrefetch() const;
+    void runTransaction(Transaction *trans);
+    void cancelPrefetch(const QString &tid);
+
+    /**
+     * Has background transactions yield their bandwidth while a transaction
+     * of a higher priority downloads, see Transaction::setBandwidthYielding().
+     */
+    void updateBandwidthShares();
     
 signals:
     void queueChanged(const QString &active,
@@ -59,7 +127,10 @@ public slots:
 
 private slots:
     void onTransactionFinished();
-    void runNextTransaction();
+    void onTransactionPreempted();
+    void onTransactionPropertyChanged(int property, QDBusVariant value);
+    void onPrefetchFinished(const QString &tid, bool cancelled);
+    void runNextTransactions();
     void emitQueueChanged();
 };
 
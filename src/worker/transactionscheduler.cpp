@@ -0,0 +1,290 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#include "transactionscheduler.h"
+
+TransactionScheduler::TransactionScheduler(int maxRunning)
+    : m_maxRunning(qMax(1, maxRunning))
+    , m_nextSequence(0)
+{
+}
+
+TransactionScheduler::Resources TransactionScheduler::roleResources(QApt::TransactionRole role)
+{
+    switch (role) {
+    case QApt::UpdateCacheRole:
+        return ListsResource;
+    case QApt::CommitChangesRole:
+    case QApt::UpgradeSystemRole:
+        return ArchivesResource | StatusResource;
+    case QApt::InstallFileRole:
+        return StatusResource;
+    case QApt::DownloadArchivesRole:
+        // Downloads into a directory of the client's choosing
+        return NoResources;
+    case QApt::RebuildCacheRole:
+        // Only reads what the cache is built from, which apt and dpkg
+        // replace atomically. The cache is only marked as checked if that
+        // hasn't changed meanwhile, see AptWorker::markDiskCacheChecked()
+        return NoResources;
+    case QApt::EmptyRole:
+    default:
+        return ExclusiveResource;
+    }
+}
+
+int TransactionScheduler::maxRunning() const
+{
+    return m_maxRunning;
+}
+
+void TransactionScheduler::enqueue(const QString &id, Resources resources,
+                                   QApt::TransactionPriority priority)
+{
+    Entry entry;
+    entry.id = id;
+    entry.resources = resources;
+    entry.priority = priority;
+    entry.sequence = m_nextSequence++;
+
+    insertQueued(entry);
+}
+
+void TransactionScheduler::insertQueued(const Entry &entry)
+{
+    int i = 0;
+    for (; i < m_queued.size(); ++i) {
+        const Entry &queued = m_queued.at(i);
+
+        if (queued.priority < entry.priority ||
+            (queued.priority == entry.priority && queued.sequence > entry.sequence)) {
+            break;
+        }
+    }
+
+    m_queued.insert(i, entry);
+}
+
+bool TransactionScheduler::conflicts(const Entry &first, const Entry &second)
+{
+    if ((first.resources | second.resources) & ExclusiveResource)
+        return true;
+
+    return first.resources & second.resources;
+}
+
+bool TransactionScheduler::remove(const QString &id)
+{
+    for (int i = 0; i < m_queued.size(); ++i) {
+        if (m_queued.at(i).id == id) {
+            m_queued.removeAt(i);
+            return true;
+        }
+    }
+
+    for (QList<Entry> &members : m_coalesced) {
+        for (int i = 0; i < members.size(); ++i) {
+            if (members.at(i).id == id) {
+                members.removeAt(i);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+QStringList TransactionScheduler::schedule()
+{
+    QStringList started;
+
+    Resources busy;
+    for (const Entry &entry : m_running)
+        busy |= entry.resources;
+
+    // Resources needed by transactions that have to keep waiting
+    Resources reserved;
+    bool waiting = false;
+
+    for (auto iter = m_queued.begin(); iter != m_queued.end();) {
+        // Leave a slot for the first waiting transaction
+        const int freeSlots = m_maxRunning - m_running.size();
+        if (freeSlots <= 0 || (waiting && freeSlots <= 1))
+            break;
+
+        bool canStart;
+        if (busy & ExclusiveResource)
+            canStart = false;
+        else if (iter->resources & ExclusiveResource)
+            canStart = m_running.isEmpty() && !waiting;
+        else
+            canStart = !(iter->resources & (busy | reserved));
+
+        if (!canStart) {
+            // Nothing overtakes a transaction that needs to run alone
+            if (iter->resources & ExclusiveResource)
+                break;
+
+            reserved |= iter->resources;
+            waiting = true;
+            ++iter;
+            continue;
+        }
+
+        busy |= iter->resources;
+        started.append(iter->id);
+        m_running.append(*iter);
+        iter = m_queued.erase(iter);
+    }
+
+    return started;
+}
+
+void TransactionScheduler::finish(const QString &id)
+{
+    for (int i = 0; i < m_running.size(); ++i) {
+        if (m_running.at(i).id == id) {
+            m_running.removeAt(i);
+            m_coalesced.remove(id);
+            return;
+        }
+    }
+}
+
+bool TransactionScheduler::requeue(const QString &id)
+{
+    for (int i = 0; i < m_running.size(); ++i) {
+        if (m_running.at(i).id == id) {
+            insertQueued(m_running.takeAt(i));
+
+            for (const Entry &member : m_coalesced.take(id))
+                insertQueued(member);
+
+            return true;
+        }
+    }
+
+    for (QList<Entry> &members : m_coalesced) {
+        for (int i = 0; i < members.size(); ++i) {
+            if (members.at(i).id == id) {
+                insertQueued(members.takeAt(i));
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool TransactionScheduler::coalesce(const QString &leadId, const QString &id)
+{
+    const Entry *lead = nullptr;
+    for (const Entry &entry : m_running) {
+        if (entry.id == leadId) {
+            lead = &entry;
+            break;
+        }
+    }
+
+    if (!lead)
+        return false;
+
+    for (int i = 0; i < m_queued.size(); ++i) {
+        if (m_queued.at(i).id != id)
+            continue;
+
+        if (m_queued.at(i).resources != lead->resources)
+            return false;
+
+        m_coalesced[leadId].append(m_queued.takeAt(i));
+        return true;
+    }
+
+    return false;
+}
+
+QStringList TransactionScheduler::coalesced(const QString &leadId) const
+{
+    QStringList ids;
+    for (const Entry &entry : m_coalesced.value(leadId))
+        ids.append(entry.id);
+
+    return ids;
+}
+
+QStringList TransactionScheduler::preemptionCandidates() const
+{
+    if (m_queued.isEmpty() || m_queued.first().priority == QApt::BackgroundPriority)
+        return QStringList();
+
+    const Entry &head = m_queued.first();
+    QStringList candidates;
+    QString spare;
+    int remaining = 0;
+
+    for (const Entry &entry : m_running) {
+        if (!conflicts(head, entry)) {
+            // The most recently started one loses the least work
+            if (entry.priority == QApt::BackgroundPriority)
+                spare = entry.id;
+
+            ++remaining;
+            continue;
+        }
+
+        // Only background work makes way
+        if (entry.priority != QApt::BackgroundPriority)
+            return QStringList();
+
+        candidates.append(entry.id);
+    }
+
+    if (remaining >= m_maxRunning) {
+        if (spare.isEmpty())
+            return QStringList();
+
+        candidates.append(spare);
+    }
+
+    return candidates;
+}
+
+QStringList TransactionScheduler::running() const
+{
+    QStringList ids;
+    for (const Entry &entry : m_running)
+        ids.append(entry.id);
+
+    return ids;
+}
+
+QStringList TransactionScheduler::queued() const
+{
+    QStringList ids;
+    for (const Entry &entry : m_queued)
+        ids.append(entry.id);
+
+    return ids;
+}
+
+bool TransactionScheduler::isEmpty() const
+{
+    return m_running.isEmpty() && m_queued.isEmpty();
+}
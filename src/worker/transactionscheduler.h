@@ -0,0 +1,167 @@
+/***************************************************************************
+ *   Copyright © 2026 The LingmoOS Developers                              *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or         *
+ *   modify it under the terms of the GNU General Public License as        *
+ *   published by the Free Software Foundation; either version 2 of        *
+ *   the License or (at your option) version 3 or any later version        *
+ *   accepted by the membership of KDE e.V. (or its successor approved     *
+ *   by the membership of KDE e.V.), which shall act as a proxy            *
+ *   defined in Section 14 of version 3 of the license.                    *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef TRANSACTIONSCHEDULER_H
+#define TRANSACTIONSCHEDULER_H
+
+#include <QFlags>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+
+#include "globals.h"
+
+/**
+ * Decides which queued transactions may run at the same time.
+ *
+ * Every transaction declares the package system resources it uses.
+ * Transactions that share no resource can run concurrently, up to a fixed
+ * number of running transactions.
+ *
+ * Transactions are queued by priority, and in the order they were queued
+ * within a priority. They start in queue order, but a later transaction
+ * may overtake one that is waiting for a busy resource. To keep waiting
+ * transactions from being starved, the overtaking transaction may not use
+ * any resource that an earlier waiting transaction needs, and it may not
+ * take the last free slot. Transactions of a lower priority can still be
+ * starved by a steady stream of higher priority ones.
+ *
+ * A running transaction can carry out the changes of queued transactions
+ * as well, see coalesce(). Those leave the queue, and finish along with
+ * the transaction that carries them.
+ *
+ * The scheduler only keeps track of transaction ids, so that it can be
+ * used and tested without a package system.
+ */
+class TransactionScheduler
+{
+public:
+    enum Resource {
+        NoResources = 0,
+        /// The package lists in Dir::State::lists
+        ListsResource = 1 << 0,
+        /// The package archive cache in Dir::Cache::archives
+        ArchivesResource = 1 << 1,
+        /// The dpkg status database
+        StatusResource = 1 << 2,
+        /// Process-wide state, such as the environment. Conflicts with
+        /// every other transaction
+        ExclusiveResource = 1 << 3
+    };
+    Q_DECLARE_FLAGS(Resources, Resource)
+
+    explicit TransactionScheduler(int maxRunning = 1);
+
+    /**
+     * Returns the resources that a transaction with the given @p role uses.
+     * These are also the APT locks a worker takes for the transaction.
+     */
+    static Resources roleResources(QApt::TransactionRole role);
+
+    int maxRunning() const;
+
+    /**
+     * Queues the transaction @p id, which uses @p resources, behind every
+     * queued transaction of the same or a higher @p priority.
+     */
+    void enqueue(const QString &id, Resources resources,
+                 QApt::TransactionPriority priority = QApt::NormalPriority);
+
+    /**
+     * Removes the queued transaction @p id, or a transaction coalesced into
+     * a running one.
+     *
+     * @return @c false if @p id is not queued, e.g. because it is running
+     */
+    bool remove(const QString &id);
+
+    /**
+     * Moves every queued transaction that can start now to the running
+     * transactions.
+     *
+     * @return the ids of the transactions to start, in queue order
+     */
+    QStringList schedule();
+
+    /**
+     * Marks the running transaction @p id as done, freeing its resources.
+     * Transactions coalesced into it are done as well. Call schedule()
+     * afterwards to start waiting transactions.
+     */
+    void finish(const QString &id);
+
+    /**
+     * Moves the running transaction @p id back to the queue, at the place
+     * it had when it was first queued. Transactions coalesced into it go
+     * back as well. A transaction coalesced into a running one can also be
+     * requeued on its own.
+     *
+     * @return @c false if @p id is neither running nor coalesced
+     */
+    bool requeue(const QString &id);
+
+    /**
+     * Takes the queued transaction @p id out of the queue, to be carried
+     * out by the running transaction @p leadId. Both have to use the same
+     * resources.
+     *
+     * @return @c false if @p id is not queued or @p leadId is not running
+     */
+    bool coalesce(const QString &leadId, const QString &id);
+
+    /// Returns the ids of the transactions coalesced into @p leadId
+    QStringList coalesced(const QString &leadId) const;
+
+    /**
+     * Returns the running background transactions that keep the first
+     * queued transaction from starting, if that one has a higher priority.
+     * Nothing is returned unless requeueing all of them would let it start.
+     */
+    QStringList preemptionCandidates() const;
+
+    /// Returns the ids of the running transactions, in the order they started
+    QStringList running() const;
+
+    /// Returns the ids of the queued transactions, in queue order
+    QStringList queued() const;
+
+    bool isEmpty() const;
+
+private:
+    struct Entry {
+        QString id;
+        Resources resources;
+        QApt::TransactionPriority priority;
+        quint64 sequence;
+    };
+
+    QList<Entry> m_running;
+    QList<Entry> m_queued;
+    QHash<QString, QList<Entry>> m_coalesced;
+    int m_maxRunning;
+    quint64 m_nextSequence;
+
+    void insertQueued(const Entry &entry);
+    static bool conflicts(const Entry &first, const Entry &second);
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(TransactionScheduler::Resources)
+
+#endif // TRANSACTIONSCHEDULER_H
@@ -27,12 +27,14 @@
 #include <QStringBuilder>
 
 // Apt-pkg includes
+#include <apt-pkg/configuration.h>
 #include <apt-pkg/error.h>
 #include <apt-pkg/acquire-item.h>
 #include <apt-pkg/acquire-worker.h>
 
 // Own includes
 #include "aptworker.h"
+#include "streaminginstall.h"
 #include "transaction.hpp"
 
 #include <unistd.h>
@@ -41,6 +43,9 @@ using namespace std;
 
 WorkerAcquire::WorkerAcquire(QObject *parent, int begin, int end)
         : QObject(parent)
+        , m_trans(nullptr)
+        , m_streamingInstall(nullptr)
+        , m_progressReported(true)
         , m_calculatingSpeed(true)
         , m_progressBegin(begin)
         , m_progressEnd(end)
@@ -49,11 +54,60 @@ WorkerAcquire::WorkerAcquire(QObject *parent, int begin, int end)
     MorePulses = true;
 }
 
+WorkerAcquire::~WorkerAcquire()
+{
+    // Give the next transaction the APT configuration back
+    while (!m_savedConfig.isEmpty()) {
+        const ConfigEntry entry = m_savedConfig.takeLast();
+
+        if (entry.existed)
+            _config->Set(entry.name, entry.value);
+        else
+            _config->Clear(entry.name);
+    }
+}
+
 void WorkerAcquire::setTransaction(Transaction *trans)
 {
     m_trans = trans;
+
+    // The queue runs transactions with a proxy or download settings on their
+    // own, since the configuration is shared by all workers. The proxy is
+    // passed to the methods when they start, unlike an http_proxy variable
+    // it doesn't outlive the transaction. The queue mode and
+    // limit are read when pkgAcquire is created, the retries when items are
+    // queued, and the pipeline depth by the methods when they start
     if (!trans->proxy().isEmpty())
-        setenv("http_proxy", m_trans->proxy().toLatin1(), 1);
+        overrideConfig("Acquire::http::Proxy", trans->proxy().toStdString());
+    if (!trans->queueMode().isEmpty())
+        overrideConfig("Acquire::Queue-Mode", trans->queueMode().toStdString());
+    if (trans->maxParallelDownloads() >= 0)
+        overrideConfig("Acquire::QueueHost::Limit", std::to_string(trans->maxParallelDownloads()));
+    if (trans->pipelineDepth() >= 0)
+        overrideConfig("Acquire::http::Pipeline-Depth", std::to_string(trans->pipelineDepth()));
+    if (trans->downloadRetries() >= 0)
+        overrideConfig("Acquire::Retries", std::to_string(trans->downloadRetries()));
+}
+
+void WorkerAcquire::overrideConfig(const std::string &name, const std::string &value)
+{
+    ConfigEntry entry;
+    entry.name = name;
+    entry.value = _config->Find(name);
+    entry.existed = _config->Exists(name);
+    m_savedConfig.append(entry);
+
+    _config->Set(name, value);
+}
+
+void WorkerAcquire::setStreamingInstall(StreamingInstall *install)
+{
+    m_streamingInstall = install;
+}
+
+void WorkerAcquire::setProgressReported(bool reported)
+{
+    m_progressReported = reported;
 }
 
 void WorkerAcquire::Start()
@@ -115,7 +169,11 @@ void WorkerAcquire::Fail(pkgAcquire::ItemDesc &item)
 
 void WorkerAcquire::Stop()
 {
-    m_trans->setProgress(m_progressEnd);
+    // The fetcher shuts the methods down next
+    m_limiter.resume();
+    publishChangedItems();
+    if (m_progressReported)
+        m_trans->setProgress(m_progressEnd);
     m_trans->setCancellable(false);
     pkgAcquireStatus::Stop();
 }
@@ -126,14 +184,16 @@ bool WorkerAcquire::MediaChange(string Media, string Drive)
     if (!(m_trans->frontendCaps() & QApt::MediumPromptCap))
         return false;
 
+    // Don't keep the other downloads stopped while waiting for the user
+    m_limiter.resume();
+
     // Notify listeners to the transaction
     m_trans->setMediumRequired(QString::fromUtf8(Media.c_str()),
                                QString::fromUtf8(Drive.c_str()));
     m_trans->setStatus(QApt::WaitingMediumStatus);
 
     // Wait until the media is provided or the user cancels
-    while (m_trans->isPaused())
-        usleep(200000);
+    m_trans->waitWhilePaused();
 
     m_trans->setStatus(QApt::DownloadingStatus);
 
@@ -143,10 +203,12 @@ bool WorkerAcquire::MediaChange(string Media, string Drive)
 
 bool WorkerAcquire::Pulse(pkgAcquire *Owner)
 {
-    if (m_trans->isCancelled())
+    // Stopping keeps partial files, so a preempted download resumes later
+    if (m_trans->isCancelled() || m_trans->preemptIfRequested())
         return false;
 
     pkgAcquireStatus::Pulse(Owner);
+    m_limiter.pulse(Owner, m_trans->effectiveDownloadLimit());
 
     for (pkgAcquire::Worker *iter = Owner->WorkersBegin(); iter != 0; iter = Owner->WorkerStep(iter)) {
         if (!iter->CurrentItem) {
@@ -162,6 +224,8 @@ bool WorkerAcquire::Pulse(pkgAcquire *Owner)
         updateStatus(*iter->CurrentItem);
     }
 
+    publishChangedItems();
+
     int percentage = qRound(double((CurrentBytes + CurrentItems) * 100.0)/double (TotalBytes + TotalItems));
     int progress = 0;
     // work-around a stupid problem with libapt-pkg
@@ -172,11 +236,13 @@ bool WorkerAcquire::Pulse(pkgAcquire *Owner)
     // Calculate global progress, adjusted for given beginning and ending points
     progress = qRound(m_progressBegin + qreal(percentage / 100.0) * (m_progressEnd - m_progressBegin));
 
-    if (m_lastProgress > progress)
-        m_trans->setProgress(101);
-    else {
-        m_trans->setProgress(progress);
-        m_lastProgress = progress;
+    if (m_progressReported) {
+        if (m_lastProgress > progress)
+            m_trans->setProgress(101);
+        else {
+            m_trans->setProgress(progress);
+            m_lastProgress = progress;
+        }
     }
 
     quint64 ETA = 0;
@@ -192,6 +258,10 @@ bool WorkerAcquire::Pulse(pkgAcquire *Owner)
     m_trans->setETA(ETA);
 
     Update = false;
+
+    if (m_streamingInstall)
+        return m_streamingInstall->pulse(Owner, this);
+
     return true;
 }
 
@@ -239,5 +309,36 @@ void WorkerAcquire::updateStatus(const pkgAcquire::ItemDesc &Itm)
     QApt::DownloadProgress dp(URI, downloadStatus, shortDesc,
                               fileSize, fetchedSize, message);
 
-    m_trans->setDownloadProgress(dp);
+    // Only rows that actually changed are sent
+    auto item = m_items.find(URI);
+    if (item != m_items.end()) {
+        if (*item == dp)
+            return;
+
+        *item = dp;
+
+        for (QApt::DownloadProgress &changed : m_changedItems) {
+            if (changed.uri() == URI) {
+                changed = dp;
+                return;
+            }
+        }
+    } else {
+        m_items.insert(URI, dp);
+    }
+
+    m_changedItems.append(dp);
+}
+
+void WorkerAcquire::publishChangedItems()
+{
+    if (m_changedItems.isEmpty())
+        return;
+
+    m_trans->setDownloadItems(m_changedItems);
+
+    // Keep the single item property up to date for older clients
+    m_trans->setDownloadProgress(m_changedItems.last());
+
+    m_changedItems.clear();
 }
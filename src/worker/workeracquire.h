@@ -22,11 +22,17 @@
 #define WORKERACQUIRE_H
 
 // Qt includes
+#include <QHash>
 #include <QObject>
 
 // Apt-pkg includes
 #include <apt-pkg/acquire.h>
 
+// Own includes
+#include "bandwidthlimiter.h"
+#include "downloadprogress.h"
+
+class StreamingInstall;
 class Transaction;
 
 class WorkerAcquire : public QObject, public pkgAcquireStatus
@@ -34,6 +40,7 @@ class WorkerAcquire : public QObject, public pkgAcquireStatus
     Q_OBJECT
 public:
     explicit WorkerAcquire(QObject *parent, int begin = 0, int end = 100);
+    ~WorkerAcquire();
 
     void Start();
     void IMSHit(pkgAcquire::ItemDesc &Itm);
@@ -45,14 +52,52 @@ public:
 
     bool Pulse(pkgAcquire *Owner);
 
+    /**
+     * Sets the transaction to report to. Its proxy and download settings
+     * are applied to the process-wide APT configuration until the
+     * WorkerAcquire is deleted, so call this before creating the
+     * pkgAcquire, and delete the WorkerAcquire once the fetch is done.
+     */
     void setTransaction(Transaction *trans);
 
+    /**
+     * Gives @p install a chance to start installing on every pulse.
+     */
+    void setStreamingInstall(StreamingInstall *install);
+
+    /**
+     * Sets whether the download progress is reported as the progress of the
+     * transaction. The download items, speed and ETA are always reported.
+     */
+    void setProgressReported(bool reported);
+
 private:
     Transaction *m_trans;
+    StreamingInstall *m_streamingInstall;
+    bool m_progressReported;
     bool m_calculatingSpeed;
     int m_progressBegin;
     int m_progressEnd;
     int m_lastProgress;
+    // The last published state of every item, by URI
+    QHash<QString, QApt::DownloadProgress> m_items;
+    QApt::DownloadProgressList m_changedItems;
+    BandwidthLimiter m_limiter;
+
+    struct ConfigEntry {
+        std::string name;
+        std::string value;
+        bool existed;
+    };
+    // APT configuration overridden for the transaction, in order of change
+    QList<ConfigEntry> m_savedConfig;
+
+    void overrideConfig(const std::string &name, const std::string &value);
+
+    /**
+     * Publishes the items that changed since the last call as one update.
+     */
+    void publishChangedItems();
 
 private Q_SLOTS:
     void updateStatus(const pkgAcquire::ItemDesc &Itm);
@@ -21,42 +21,49 @@
 #include "workerdaemon.h"
 
 // Qt includes
-#include <QThread>
+#include <QDateTime>
 #include <QTimer>
 
 // Apt-pkg includes
 #include <apt-pkg/configuration.h>
 
+// System includes
+#include <stdlib.h>
+
 // Own includes
 #include "aptworker.h"
-#include "qaptauthorization.h"
+#include "authorizer.h"
+#include "cacheprewarmer.h"
+#include "peerserver.h"
 #include "transaction.hpp"
 #include "transactionqueue.h"
 #include "workeradaptor.h"
 #include "urihelper.h"
 
 #define IDLE_TIMEOUT 30000 // 30 seconds
+#define WORKER_COUNT 3 // One for each of lists, archives and dpkg status
 
 WorkerDaemon::WorkerDaemon(int &argc, char **argv)
     : QCoreApplication(argc, argv)
     , m_queue(nullptr)
-    , m_worker(nullptr)
-    , m_workerThread(nullptr)
+    , m_peerServer(nullptr)
+    , m_prewarmer(nullptr)
+    , m_resident(false)
 {
-    m_worker = new AptWorker(nullptr);
-    m_queue = new TransactionQueue(this, m_worker);
+    // The environment can't be changed safely once the workers run, so it
+    // is set up here for all transactions. What differs between them is set
+    // in the processes started for them
+    setenv("PATH", "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin", 1);
+    setenv("APT_LISTBUGS_FRONTEND", "none", 1);
+    setenv("APT_LISTCHANGES_FRONTEND", "debconf", 1);
 
-    m_workerThread = new QThread(this);
-    m_worker->moveToThread(m_workerThread);
-    m_workerThread->start();
-    connect(m_workerThread, SIGNAL(finished()), this, SLOT(quit()));
+    qRegisterMetaType<Transaction *>("Transaction *");
+    m_queue = new TransactionQueue(this, WORKER_COUNT);
+    m_peerServer = new PeerServer(this);
 
-    // Invoke with Qt::QueuedConnection since the Qt event loop isn't up yet
-    QMetaObject::invokeMethod(m_worker, "init", Qt::QueuedConnection);
     connect(m_queue, SIGNAL(queueChanged(QString,QStringList)),
             this, SIGNAL(transactionQueueChanged(QString,QStringList)),
             Qt::QueuedConnection);
-    qRegisterMetaType<Transaction *>("Transaction *");
     QApt::DownloadProgress::registerMetaTypes();
 
     // Start up D-Bus service
@@ -75,6 +82,16 @@ WorkerDaemon::WorkerDaemon(int &argc, char **argv)
         return;
     }
 
+    // A resident worker doesn't quit when idle, and keeps the package cache
+    // current for the next transaction. It can be started with --resident,
+    // e.g. by a system service, or be made resident by the APT configuration
+    AptWorker::initSystem();
+    m_resident = (arguments().contains(QLatin1String("--resident")) ||
+                  _config->FindB("QApt::Worker::Resident", false));
+
+    if (m_resident)
+        m_prewarmer = new CachePrewarmer(m_queue, this);
+
     // Quit if we've not run a job for a while
     m_idleTimer = new QTimer(this);
     m_idleTimer->start(IDLE_TIMEOUT);
@@ -84,10 +101,10 @@ WorkerDaemon::WorkerDaemon(int &argc, char **argv)
 void WorkerDaemon::checkIdle()
 {
     quint64 currentTime = QDateTime::currentMSecsSinceEpoch();
-    if (!m_worker->currentTransaction() &&
-        currentTime - m_worker->lastActiveTimestamp() > IDLE_TIMEOUT &&
-        m_queue->isEmpty()) {
-        m_worker->quit();
+    if (!m_resident && m_queue->isEmpty() &&
+        currentTime - m_queue->lastActiveTimestamp() > IDLE_TIMEOUT) {
+        m_queue->stop();
+        quit();
     }
 }
 
@@ -103,6 +120,7 @@ Transaction *WorkerDaemon::createTransaction(QApt::TransactionRole role, QVarian
     // Create a transaction. It will add itself to the queue
     Transaction *trans = new Transaction(m_queue, uid, role, instructionsList);
     trans->setService(message().service());
+    trans->setPeerServer(m_peerServer);
 
     return trans;
 }
@@ -152,13 +170,122 @@ QString WorkerDaemon::downloadArchives(const QStringList &packageNames, const QS
     return trans->transactionId();
 }
 
+QVariantMap WorkerDaemon::startTransaction(int role, QVariantMap instructionsList,
+                                          QVariantMap properties)
+{
+    QApt::TransactionRole transactionRole = (QApt::TransactionRole)role;
+
+    switch (transactionRole) {
+    case QApt::UpdateCacheRole:
+    case QApt::UpgradeSystemRole:
+    case QApt::CommitChangesRole:
+    case QApt::InstallFileRole:
+    case QApt::DownloadArchivesRole:
+    case QApt::RebuildCacheRole:
+        break;
+    default:
+        sendErrorReply(QDBusError::InvalidArgs);
+        return QVariantMap();
+    }
+
+    Transaction *trans = createTransaction(transactionRole, instructionsList);
+
+    if (!trans->setup(properties)) {
+        sendErrorReply(QDBusError::InvalidArgs);
+        m_queue->removePending(trans);
+        return QVariantMap();
+    }
+
+    // The transaction replies once it has been authorized
+    setDelayedReply(true);
+    trans->start(connection(), message());
+
+    return QVariantMap();
+}
+
+bool WorkerDaemon::rebuildCache()
+{
+    // Runs a transaction for the rebuild, so that it is queued like any
+    // other work, and replies once it is done. This needs no authorization,
+    // since it only writes what any root process opening the cache would
+    Transaction *trans = createTransaction(QApt::RebuildCacheRole);
+
+    setDelayedReply(true);
+    m_cacheRebuilds.insert(trans, message());
+    connect(trans, SIGNAL(finished(int)), this, SLOT(onCacheRebuilt(int)));
+    trans->enqueue();
+
+    return false;
+}
+
+void WorkerDaemon::onCacheRebuilt(int exitStatus)
+{
+    Transaction *trans = qobject_cast<Transaction *>(sender());
+
+    if (!m_cacheRebuilds.contains(trans))
+        return;
+
+    const QDBusMessage message = m_cacheRebuilds.take(trans);
+    QDBusConnection::systemBus().send(message.createReply(exitStatus == QApt::ExitSuccess));
+}
+
 bool WorkerDaemon::writeFileToDisk(const QString &contents, const QString &path)
 {
-    if (!QApt::Auth::authorize(dbusActionUri("writefiletodisk"), message().service())) {
+    Q_UNUSED(contents)
+    Q_UNUSED(path)
+
+    authorizeCall(dbusActionUri("writefiletodisk"), SLOT(writeFileAuthorized(bool)));
+
+    return false;
+}
+
+bool WorkerDaemon::copyArchiveToCache(const QString &archivePath)
+{
+    Q_UNUSED(archivePath)
+
+    authorizeCall(dbusActionUri("writefiletodisk"), SLOT(copyArchiveAuthorized(bool)));
+
+    return false;
+}
+
+void WorkerDaemon::authorizeCall(const QString &action, const char *member)
+{
+    // Reply once authorized, without blocking other clients meanwhile
+    setDelayedReply(true);
+
+    AuthorizationRequest *request = Authorizer::instance()->authorize(action, message().service());
+    request->setCaller(connection(), message());
+    connect(request, SIGNAL(finished(bool)), this, member);
+}
+
+void WorkerDaemon::writeFileAuthorized(bool authorized)
+{
+    AuthorizationRequest *request = qobject_cast<AuthorizationRequest *>(sender());
+
+    if (!authorized) {
         qDebug() << "Failed to authorize!!";
-        return false;
+        request->sendReply(false);
+        return;
+    }
+
+    const QList<QVariant> arguments = request->message().arguments();
+    request->sendReply(writeFile(arguments.at(0).toString(), arguments.at(1).toString()));
+}
+
+void WorkerDaemon::copyArchiveAuthorized(bool authorized)
+{
+    AuthorizationRequest *request = qobject_cast<AuthorizationRequest *>(sender());
+
+    if (!authorized) {
+        request->sendReply(false);
+        return;
     }
 
+    request->sendReply(copyArchive(request->message().arguments().at(0).toString()));
+}
+
+bool WorkerDaemon::writeFile(const QString &contents, const QString &path)
+{
     QFile file(path);
 
     if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
@@ -170,12 +297,8 @@ bool WorkerDaemon::writeFileToDisk(const QString &contents, const QString &path)
     return false;
 }
 
-bool WorkerDaemon::copyArchiveToCache(const QString &archivePath)
+bool WorkerDaemon::copyArchive(const QString &archivePath)
 {
-    if (!QApt::Auth::authorize(dbusActionUri("writefiletodisk"), message().service())) {
-        return false;
-    }
-
     QString cachePath = QString::fromStdString(_config->FindDir("Dir::Cache::Archives"));
     // Filename
     cachePath += archivePath.right(archivePath.size() - archivePath.lastIndexOf('/'));
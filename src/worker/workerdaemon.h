@@ -23,13 +23,15 @@
 
 #include <QCoreApplication>
 #include <QDBusContext>
+#include <QDBusMessage>
+#include <QHash>
 
 #include "globals.h"
 
-class QThread;
 class QTimer;
 
-class AptWorker;
+class CachePrewarmer;
+class PeerServer;
 class Transaction;
 class TransactionQueue;
 
@@ -43,11 +45,17 @@ public:
 
 private:
     TransactionQueue *m_queue;
-    AptWorker *m_worker;
-    QThread *m_workerThread;
     QTimer *m_idleTimer;
+    PeerServer *m_peerServer;
+    CachePrewarmer *m_prewarmer;
+    bool m_resident;
+    // Replies to rebuildCache() calls, sent when their transaction is done
+    QHash<Transaction *, QDBusMessage> m_cacheRebuilds;
 
     int dbusSenderUid() const;
+    void authorizeCall(const QString &action, const char *member);
+    bool writeFile(const QString &contents, const QString &path);
+    bool copyArchive(const QString &archivePath);
     Transaction *createTransaction(QApt::TransactionRole role,
                                    QVariantMap instructionsList = QVariantMap());
 
@@ -63,12 +71,21 @@ public slots:
     QString upgradeSystem(bool safeUpgrade);
     QString downloadArchives(const QStringList &packageNames, const QString &dest);
 
+    // Creates, sets up and runs a transaction in one call. Returns the
+    // properties of the new transaction
+    QVariantMap startTransaction(int role, QVariantMap instructionsList,
+                                 QVariantMap properties);
+
     // Synchronous methods
+    bool rebuildCache();
     bool writeFileToDisk(const QString &contents, const QString &path);
     bool copyArchiveToCache(const QString &archivePath);
 
 private slots:
     void checkIdle();
+    void onCacheRebuilt(int exitStatus);
+    void writeFileAuthorized(bool authorized);
+    void copyArchiveAuthorized(bool authorized);
 };
 
 #endif // WORKERDAEMON_H
@@ -23,17 +23,18 @@
 
 #include <QStringBuilder>
 #include <QStringList>
-#include <QTextCodec>
 #include <QDebug>
 
 #include <apt-pkg/error.h>
 #include <apt-pkg/install-progress.h>
 
 #include <errno.h>
+#include <poll.h>
 #include <sys/statvfs.h>
 #include <sys/statfs.h>
 #include <sys/wait.h>
 #include <sys/fcntl.h>
+#include <sys/syscall.h>
 #include <pty.h>
 #include <unistd.h>
 
@@ -46,71 +47,93 @@ using namespace std;
 
 WorkerInstallProgress::WorkerInstallProgress(int begin, int end)
         : m_trans(nullptr)
+        , m_child_id(-1)
+        , m_result(pkgPackageManager::Failed)
+        , m_statusFd(-1)
+        , m_ptyFd(-1)
+        , m_childFd(-1)
+        , m_statusOpen(false)
+        , m_ptyOpen(false)
+        , m_childStatus(0)
         , m_startCounting(false)
         , m_progressBegin(begin)
         , m_progressEnd(end)
+        , m_confFilePending(false)
 {
-    setenv("APT_LISTBUGS_FRONTEND", "none", 1);
-    setenv("APT_LISTCHANGES_FRONTEND", "debconf", 1);
 }
 
 void WorkerInstallProgress::setTransaction(Transaction *trans)
 {
     m_trans = trans;
-    std::setlocale(LC_ALL, m_trans->locale().toLatin1());
-
-    // FIXME: bloody workaround.
-    //        Since QLocale::system and consequently QTextCodec::forLocale is
-    //        set way before we get here there's a need to manually override
-    //        the already set default codec with that is requested by the client.
-    //        Since the client talks to us about posix locales however we cannot
-    //        expect a reliable mapping from split(.).last() to a proper codec.
-    //        Also there is no explicit Qt api to translate a given posix locale
-    //        to QLocale & QTextCodec.
-    //        Ultimately transactions should get new properties for QLocale::name
-    //        and QTextCodec::name, assuming generally meaningful values we can
-    //        through those properties accurately recreate the client locale env.
-    if (m_trans->locale().contains(QChar('.'))) {
-        QTextCodec *codec = QTextCodec::codecForName(m_trans->locale().split(QChar('.')).last().toUtf8());
-        QTextCodec::setCodecForLocale(codec);
-    }
 
-    if ((trans->frontendCaps() & QApt::DebconfCap) && !trans->debconfPipe().isEmpty()) {
-        setenv("DEBIAN_FRONTEND", "passthrough", 1);
-        setenv("DEBCONF_PIPE", trans->debconfPipe().toLatin1(), 1);
-    } else {
-        setenv("DEBIAN_FRONTEND", "noninteractive", 1);
-    }
+    // Applied in the child process only, since the locale and environment
+    // of the worker are shared by the transactions running concurrently
+    m_locale = trans->locale().toLatin1();
+    m_debconfPipe.clear();
+    if ((trans->frontendCaps() & QApt::DebconfCap) && !trans->debconfPipe().isEmpty())
+        m_debconfPipe = trans->debconfPipe().toLatin1();
+}
+
+void WorkerInstallProgress::setProgressRange(int begin, int end)
+{
+    m_progressBegin = begin;
+    m_progressEnd = end;
 }
 
 pkgPackageManager::OrderResult WorkerInstallProgress::start(pkgPackageManager *pm)
+{
+    if (!begin(pm))
+        return m_result;
+
+    // A pidfd wakes us up as soon as the child exits. Without one, check
+    // for that every now and then
+    const int timeout = (m_childFd == -1) ? 100 : -1;
+
+    // Update the interface until the child dies
+    while (poll(timeout)) {}
+
+    return finish();
+}
+
+bool WorkerInstallProgress::begin(pkgPackageManager *pm)
 {
     m_trans->setStatus(QApt::CommittingStatus);
-    pkgPackageManager::OrderResult res;
 
-    res = pm->DoInstallPreFork();
-    if (res == pkgPackageManager::Failed) {
-        return res;
+    m_result = pm->DoInstallPreFork();
+    if (m_result == pkgPackageManager::Failed) {
+        return false;
     }
 
     int readFromChildFD[2];
 
     //Initialize both pipes
     if (pipe(readFromChildFD) < 0) {
-        return res;
+        return false;
     }
 
     int pty_master;
     m_child_id = forkpty(&pty_master, 0, 0, 0);
 
     if (m_child_id == -1) {
-        return res;
+        close(readFromChildFD[0]);
+        close(readFromChildFD[1]);
+        return false;
     } else if (m_child_id == 0) {
         // close pipe we don't need
         close(readFromChildFD[0]);
 
+        std::setlocale(LC_ALL, m_locale.constData());
+
+        if (m_debconfPipe.isEmpty()) {
+            setenv("DEBIAN_FRONTEND", "noninteractive", 1);
+            unsetenv("DEBCONF_PIPE");
+        } else {
+            setenv("DEBIAN_FRONTEND", "passthrough", 1);
+            setenv("DEBCONF_PIPE", m_debconfPipe.constData(), 1);
+        }
+
         APT::Progress::PackageManagerProgressFd progress(readFromChildFD[1]);
-        res = pm->DoInstallPostFork(&progress);
+        pkgPackageManager::OrderResult res = pm->DoInstallPostFork(&progress);
 
         // dump errors into cerr (pass it to the parent process)
         _error->DumpErrors();
@@ -120,112 +143,191 @@ pkgPackageManager::OrderResult WorkerInstallProgress::start(pkgPackageManager *p
         _exit(res);
     }
 
+    // The write end belongs to the child
+    close(readFromChildFD[1]);
+    m_statusFd = readFromChildFD[0];
+    m_ptyFd = pty_master;
+
     // make it nonblocking
-    fcntl(readFromChildFD[0], F_SETFL, O_NONBLOCK);
-    fcntl(pty_master, F_SETFL, O_NONBLOCK);
+    fcntl(m_statusFd, F_SETFL, O_NONBLOCK);
+    fcntl(m_ptyFd, F_SETFL, O_NONBLOCK);
+
+    // A pidfd wakes us up as soon as the child exits. A signalfd is no
+    // option, since SIGCHLD would have to be blocked for the whole process,
+    // QProcess included
+    m_childFd = -1;
+#ifdef SYS_pidfd_open
+    m_childFd = syscall(SYS_pidfd_open, m_child_id, 0);
+#endif
+
+    m_statusOpen = true;
+    m_ptyOpen = true;
+    m_childStatus = 0;
+    m_statusBuffer.clear();
+    m_confFilePending = false;
+
+    return true;
+}
 
-    // Update the interface until the child dies
-    int ret;
-    char masterbuf[1024];
-    while (waitpid(m_child_id, &ret, WNOHANG) == 0) {
-        // Read dpkg's raw output
-        while(read(pty_master, masterbuf, sizeof(masterbuf)) > 0);
-
-        // Update high-level status info
-        updateInterface(readFromChildFD[0], pty_master);
+bool WorkerInstallProgress::poll(int timeout)
+{
+    char masterbuf[4096];
+
+    if (m_confFilePending) {
+        if (timeout != 0)
+            m_trans->waitWhilePaused();
+
+        if (!m_trans->isPaused()) {
+            answerConfFile(m_ptyFd);
+            processStatusLines(m_ptyFd);
+        }
     }
 
-    res = (pkgPackageManager::OrderResult)WEXITSTATUS(ret);
+    pollfd fds[] = {
+        { m_statusOpen ? m_statusFd : -1, POLLIN, 0 },
+        { m_ptyOpen ? m_ptyFd : -1, POLLIN, 0 },
+        { m_childFd, POLLIN, 0 }
+    };
 
-    close(readFromChildFD[0]);
-    close(readFromChildFD[1]);
-    close(pty_master);
+    if (::poll(fds, 3, timeout) < 0 && errno != EINTR)
+        usleep(100000);
+
+    // Read dpkg's raw output
+    if (fds[1].revents) {
+        ssize_t len;
+        while ((len = read(m_ptyFd, masterbuf, sizeof(masterbuf))) > 0)
+            m_trans->appendTerminalOutput(masterbuf, len);
+
+        // The pty reports EIO once the child side is gone
+        if (len == 0 || (errno != EAGAIN && errno != EINTR))
+            m_ptyOpen = false;
+    }
+
+    // Update high-level status info
+    if (fds[0].revents && !updateInterface(m_statusFd, m_ptyFd))
+        m_statusOpen = false;
 
-    return res;
+    return (waitpid(m_child_id, &m_childStatus, WNOHANG) == 0);
 }
 
-void WorkerInstallProgress::updateInterface(int fd, int writeFd)
+pkgPackageManager::OrderResult WorkerInstallProgress::finish()
 {
-    char buf[2];
-    static char line[1024] = "";
+    // Pick up status lines written right before the child exited
+    updateInterface(m_statusFd, m_ptyFd);
 
-    while (1) {
-        int len = read(fd, buf, 1);
+    m_result = (pkgPackageManager::OrderResult)WEXITSTATUS(m_childStatus);
 
-        // Status message didn't change
-        if (len < 1) {
-            break;
-        }
+    if (m_childFd != -1)
+        close(m_childFd);
+    close(m_statusFd);
+    close(m_ptyFd);
+
+    m_child_id = -1;
+    m_childFd = -1;
+    m_statusFd = -1;
+    m_ptyFd = -1;
 
-        if (buf[0] == '\n') {
-            const QStringList list = QString::fromUtf8(line).split(QLatin1Char(':'));
-            const QString status = list.at(0);
-            const QString package = list.at(1);
-            QString percent = list.at(2);
-            QString str = list.at(3);
-            // If str legitimately had a ':' in it (such as a package version)
-            // we need to retrieve the next string in the list.
-            if (list.count() == 5) {
-                str += QString(':' % list.at(4));
-            }
-
-            if (package.isEmpty() || status.isEmpty()) {
-                continue;
-            }
-
-            if (status.contains(QLatin1String("pmerror"))) {
-                // Append error string to existing error details
-                m_trans->setErrorDetails(m_trans->errorDetails() % package % '\n' % str % "\n\n");
-            } else if (status.contains(QLatin1String("pmconffile"))) {
-                // From what I understand, the original file starts after the ' character ('\'') and
-                // goes to a second ' character. The new conf file starts at the next ' and goes to
-                // the next '.
-                QStringList strList = str.split('\'');
-                QString oldFile = strList.at(1);
-                QString newFile = strList.at(2);
-
-                // Prompt for which file to use if the frontend supports that
-                if (m_trans->frontendCaps() & QApt::ConfigPromptCap) {
-                    m_trans->setConfFileConflict(oldFile, newFile);
-                    m_trans->setStatus(QApt::WaitingConfigFilePromptStatus);
-
-                    while (m_trans->isPaused())
-                        usleep(200000);
-                }
-
-                m_trans->setStatus(QApt::CommittingStatus);
-
-                if (m_trans->replaceConfFile()) {
-                    ssize_t reply = write(writeFd, "Y\n", 2);
-                    Q_UNUSED(reply);
-                } else {
-                    ssize_t reply = write(writeFd, "N\n", 2);
-                    Q_UNUSED(reply);
-                }
-            } else {
-                m_startCounting = true;
-            }
-
-            int percentage;
-            int progress;
-            if (percent.contains(QLatin1Char('.'))) {
-                QStringList percentList = percent.split(QLatin1Char('.'));
-                percentage = percentList.at(0).toInt();
-            } else {
-                percentage = percent.toInt();
-            }
-
-            progress = qRound(qreal(m_progressBegin + qreal(percentage / 100.0) * (m_progressEnd - m_progressBegin)));
-
-            m_trans->setProgress(progress);
-            m_trans->setStatusDetails(str);
-            // clean-up
-            line[0] = 0;
+    return m_result;
+}
+
+bool WorkerInstallProgress::updateInterface(int fd, int writeFd)
+{
+    char buf[4096];
+    ssize_t len;
+
+    while ((len = read(fd, buf, sizeof(buf))) > 0)
+        m_statusBuffer.append(buf, len);
+
+    const bool isOpen = (len < 0 && (errno == EAGAIN || errno == EINTR));
+
+    processStatusLines(writeFd);
+
+    return isOpen;
+}
+
+void WorkerInstallProgress::processStatusLines(int writeFd)
+{
+    int start = 0;
+    int end;
+    // What comes after a config file prompt waits for its answer
+    while (!m_confFilePending && (end = m_statusBuffer.indexOf('\n', start)) != -1) {
+        processStatusLine(m_statusBuffer.mid(start, end - start), writeFd);
+        start = end + 1;
+    }
+    m_statusBuffer.remove(0, start);
+}
+
+void WorkerInstallProgress::processStatusLine(const QByteArray &line, int writeFd)
+{
+    const QStringList list = QString::fromUtf8(line).split(QLatin1Char(':'));
+    if (list.count() < 4) {
+        return;
+    }
+
+    const QString status = list.at(0);
+    const QString package = list.at(1);
+    QString percent = list.at(2);
+    QString str = list.at(3);
+    // If str legitimately had a ':' in it (such as a package version)
+    // we need to retrieve the next string in the list.
+    if (list.count() == 5) {
+        str += QString(':' % list.at(4));
+    }
+
+    if (package.isEmpty() || status.isEmpty()) {
+        return;
+    }
+
+    if (status.contains(QLatin1String("pmerror"))) {
+        // Append error string to existing error details
+        m_trans->setErrorDetails(m_trans->errorDetails() % package % '\n' % str % "\n\n");
+    } else if (status.contains(QLatin1String("pmconffile"))) {
+        // From what I understand, the original file starts after the ' character ('\'') and
+        // goes to a second ' character. The new conf file starts at the next ' and goes to
+        // the next '.
+        QStringList strList = str.split('\'');
+        QString oldFile = strList.at(1);
+        QString newFile = strList.at(2);
+
+        // Prompt for which file to use if the frontend supports that. The
+        // answer is given by poll(), so that a streaming install doesn't
+        // hold up the downloads while the user makes up their mind
+        if (m_trans->frontendCaps() & QApt::ConfigPromptCap) {
+            m_trans->setConfFileConflict(oldFile, newFile);
+            m_trans->setStatus(QApt::WaitingConfigFilePromptStatus);
+            m_confFilePending = true;
         } else {
-            buf[1] = 0;
-            strcat(line, buf);
+            answerConfFile(writeFd);
         }
+    } else {
+        m_startCounting = true;
+    }
+
+    int percentage;
+    int progress;
+    if (percent.contains(QLatin1Char('.'))) {
+        QStringList percentList = percent.split(QLatin1Char('.'));
+        percentage = percentList.at(0).toInt();
+    } else {
+        percentage = percent.toInt();
+    }
+
+    progress = qRound(qreal(m_progressBegin + qreal(percentage / 100.0) * (m_progressEnd - m_progressBegin)));
+
+    m_trans->setProgress(progress);
+    m_trans->setStatusDetails(str);
+}
+
+void WorkerInstallProgress::answerConfFile(int writeFd)
+{
+    m_confFilePending = false;
+    m_trans->setStatus(QApt::CommittingStatus);
+
+    if (m_trans->replaceConfFile()) {
+        ssize_t reply = write(writeFd, "Y\n", 2);
+        Q_UNUSED(reply);
+    } else {
+        ssize_t reply = write(writeFd, "N\n", 2);
+        Q_UNUSED(reply);
     }
-    // 30 frames per second
-    usleep(1000000/30);
 }
@@ -22,6 +22,8 @@
 #ifndef WORKERINSTALLPROGRESS_H
 #define WORKERINSTALLPROGRESS_H
 
+#include <QByteArray>
+
 #include <apt-pkg/packagemanager.h>
 
 class Transaction;
@@ -32,17 +34,68 @@ public:
     explicit WorkerInstallProgress(int begin = 0, int end = 100);
 
     void setTransaction(Transaction *trans);
+    void setProgressRange(int begin, int end);
+
+    /**
+     * Runs the install of @p pm and blocks until it is done.
+     */
     pkgPackageManager::OrderResult start(pkgPackageManager *pm);
 
+    /**
+     * Starts the install of @p pm in a child process, for callers that want
+     * to do other work while dpkg runs. Call poll() until it returns
+     * @c false, then finish().
+     *
+     * @return @c false if the install could not be started
+     */
+    bool begin(pkgPackageManager *pm);
+
+    /**
+     * Handles the output of the install for up to @p timeout milliseconds,
+     * or until there is nothing more to read if @p timeout is 0.
+     *
+     * While a config file prompt is unanswered, a @p timeout of 0 returns
+     * right away, any other timeout waits for the answer first.
+     *
+     * @return @c false once the child process has exited
+     */
+    bool poll(int timeout);
+
+    /**
+     * Cleans up after the child process and returns the result of the
+     * install.
+     */
+    pkgPackageManager::OrderResult finish();
+
 private:
     Transaction *m_trans;
+    QByteArray m_locale;
+    // Empty unless debconf talks to the frontend
+    QByteArray m_debconfPipe;
 
     pid_t m_child_id;
+    pkgPackageManager::OrderResult m_result;
+    int m_statusFd;
+    int m_ptyFd;
+    int m_childFd;
+    bool m_statusOpen;
+    bool m_ptyOpen;
+    int m_childStatus;
     bool m_startCounting;
     int m_progressBegin;
     int m_progressEnd;
+    QByteArray m_statusBuffer;
+    // dpkg waits for the answer to a config file prompt
+    bool m_confFilePending;
 
-    void updateInterface(int fd, int writeFd);
+    /**
+     * Reads everything available from the status pipe @p fd and handles
+     * the complete lines. Returns @c false once the pipe has been closed.
+     */
+    bool updateInterface(int fd, int writeFd);
+    void processStatusLines(int writeFd);
+    void processStatusLine(const QByteArray &line, int writeFd);
+    void answerConfFile(int writeFd);
 };
 
 #endif